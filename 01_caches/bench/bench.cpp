@@ -0,0 +1,442 @@
+#include "arc.hpp"
+#include "clock.hpp"
+#include "clock_pro.hpp"
+#include "concurrent_lfu.hpp"
+#include "dense_index.hpp"
+#include "flat_index.hpp"
+#include "front_cache.hpp"
+#include "lfu.hpp"
+#include "lru.hpp"
+#include "sharded_lru.hpp"
+#include "tinylfu.hpp"
+#include "workloads.hpp"
+#include "list_lru.hpp"
+#include "map_lfu.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Every operator new of the process is counted, benchmarks report the allocations of their timed loop.
+// (The aligned forms keep the library implementation.) Not inlined: GCC would see new paired with free().
+std::atomic<uint64_t> allocations{0};
+
+[[gnu::noinline]] void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto* p = std::malloc(size != 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+[[gnu::noinline]] void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+[[gnu::noinline]] void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+[[gnu::noinline]] void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// uniform keys over twice the cache capacity: about a half of the accesses miss and evict
+std::vector<int> uniform_keys(int capacity, int n) {
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<int> dist(0, 2 * capacity - 1);
+    std::vector<int> keys(n);
+    for (auto& k : keys) {
+        k = dist(gen);
+    }
+    return keys;
+}
+
+template<class Cache>
+void BM_GetPut(benchmark::State& state) {
+    const int capacity = static_cast<int>(state.range(0));
+    const auto keys = uniform_keys(capacity, 1 << 20);
+    Cache cache(capacity);
+    int hits = 0;
+    std::size_t i = 0;
+    auto allocations_before = allocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        auto k = keys[i++ & (keys.size() - 1)];
+        if (cache.get(k) != -1) {
+            ++hits;
+        } else {
+            cache.put(k, k);
+        }
+    }
+    auto allocated = allocations.load(std::memory_order_relaxed) - allocations_before;
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["allocs_per_op"] = static_cast<double>(allocated) / state.iterations();
+}
+
+BENCHMARK_TEMPLATE(BM_GetPut, ListLRUCache)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_GetPut, LRUCache<>)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_GetPut, MapLFUCache)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_GetPut, LFUCache<>)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+// same workload through the single-probe access(), a miss hashes the key once instead of three times
+template<class Cache>
+void BM_Access(benchmark::State& state) {
+    const int capacity = static_cast<int>(state.range(0));
+    const auto keys = uniform_keys(capacity, 1 << 20);
+    Cache cache(capacity);
+    int hits = 0;
+    std::size_t i = 0;
+    for (auto _ : state) {
+        auto k = keys[i++ & (keys.size() - 1)];
+        if (cache.access(k, [k] { return k; }).second) {
+            ++hits;
+        }
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK_TEMPLATE(BM_Access, LRUCache<>)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_Access, LFUCache<>)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+// Zipf(0.99) keys over 16 times the cache capacity, popular keys scattered over the key space.
+// Generated once per capacity: the benchmark function runs several times.
+const std::vector<int>& zipf_keys(int capacity) {
+    static std::map<int, std::vector<int>> traces;
+    auto& keys = traces[capacity];
+    if (keys.empty()) {
+        std::vector<double> weights(16 * static_cast<std::size_t>(capacity));
+        for (std::size_t i = 0; i < weights.size(); ++i) {
+            weights[i] = 1.0 / std::pow(i + 1, 0.99);
+        }
+        std::mt19937 gen(42);
+        std::discrete_distribution<int> dist(weights.begin(), weights.end());
+        keys.resize(1 << 22);
+        for (auto& k : keys) {
+            k = static_cast<int>(dist(gen) * 2654435761u % 1000000007u);
+        }
+    }
+    return keys;
+}
+
+// the same requests remapped to dense keys for DenseIndex
+const std::vector<uint32_t>& dense_zipf_keys(int capacity) {
+    static std::map<int, std::vector<uint32_t>> traces;
+    auto& keys = traces[capacity];
+    if (keys.empty()) {
+        keys = remap_dense(zipf_keys(capacity)).keys;
+    }
+    return keys;
+}
+
+template<class Cache, bool Dense = false>
+void BM_ZipfAccess(benchmark::State& state) {
+    const int capacity = static_cast<int>(state.range(0));
+    const auto& keys = [capacity]() -> const auto& {
+        if constexpr (Dense) {
+            return dense_zipf_keys(capacity);
+        } else {
+            return zipf_keys(capacity);
+        }
+    }();
+    Cache cache(capacity);
+    // steady state only: the first pass fills the cache
+    for (auto k : keys) {
+        cache.access(k, [k] { return k; });
+    }
+    int hits = 0;
+    std::size_t i = 0;
+    for (auto _ : state) {
+        auto k = keys[i++ & (keys.size() - 1)];
+        if (cache.access(k, [k] { return k; }).second) {
+            ++hits;
+        }
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hit_rate"] = static_cast<double>(hits) / state.iterations();
+}
+
+using FlatLRUCache = LRUCache<int, int, std::hash<int>, FlatIndex<int>>;
+using FlatLFUCache = LFUCache<int, int, std::hash<int>, FlatIndex<int>>;
+using DenseLRUCache = LRUCache<uint32_t, uint32_t, std::hash<uint32_t>, DenseIndex<uint32_t>>;
+using DenseLFUCache = LFUCache<uint32_t, uint32_t, std::hash<uint32_t>, DenseIndex<uint32_t>>;
+
+BENCHMARK_TEMPLATE(BM_ZipfAccess, LRUCache<>)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_ZipfAccess, FlatLRUCache)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_ZipfAccess, LFUCache<>)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_ZipfAccess, FlatLFUCache)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_ZipfAccess, DenseLRUCache, true)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_ZipfAccess, DenseLFUCache, true)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+// Warm start of a cache with state.range(0) entries: loading a snapshot against replaying the puts.
+// The snapshot is written once per size and stays in the page cache, as right after a deploy.
+struct SnapshotFiles {
+    std::map<int, std::string> paths;
+    ~SnapshotFiles() {
+        for (auto& [entries, path] : paths) {
+            std::filesystem::remove(path);
+        }
+    }
+};
+
+inline int snapshot_files_count = 0;
+
+template<class Cache>
+const std::string& snapshot_file(int entries) {
+    static SnapshotFiles files;
+    auto& path = files.paths[entries];
+    if (path.empty()) {
+        auto name = "caches_bench_" + std::to_string(snapshot_files_count++) + ".snap";
+        path = (std::filesystem::temp_directory_path() / name).string();
+        Cache cache(entries);
+        for (int k = 0; k < entries; ++k) {
+            cache.put(k, k);
+        }
+        cache.save_snapshot(path);
+    }
+    return path;
+}
+
+template<class Cache>
+void BM_SnapshotRestore(benchmark::State& state) {
+    const int entries = static_cast<int>(state.range(0));
+    const auto& path = snapshot_file<Cache>(entries);
+    for (auto _ : state) {
+        Cache cache(entries);
+        cache.load_snapshot(path);
+        benchmark::DoNotOptimize(cache.size());
+    }
+    state.SetItemsProcessed(state.iterations() * entries);
+}
+
+template<class Cache>
+void BM_PutRestore(benchmark::State& state) {
+    const int entries = static_cast<int>(state.range(0));
+    for (auto _ : state) {
+        Cache cache(entries);
+        for (int k = 0; k < entries; ++k) {
+            cache.put(k, k);
+        }
+        benchmark::DoNotOptimize(cache.size());
+    }
+    state.SetItemsProcessed(state.iterations() * entries);
+}
+
+BENCHMARK_TEMPLATE(BM_SnapshotRestore, LRUCache<>)->Arg(10'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_PutRestore, LRUCache<>)->Arg(10'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_SnapshotRestore, LFUCache<>)->Arg(10'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_PutRestore, LFUCache<>)->Arg(10'000'000)->Unit(benchmark::kMillisecond);
+
+// 1M entries split into state.range(0) shards, the cache is shared by all benchmark threads
+void BM_ShardedGetPut(benchmark::State& state) {
+    static std::unique_ptr<ShardedLRUCache<>> cache;
+    const int capacity = 1 << 20;
+    const int shards = static_cast<int>(state.range(0));
+    if (state.thread_index() == 0) {
+        cache = std::make_unique<ShardedLRUCache<>>(shards, capacity / shards);
+    }
+    auto keys = uniform_keys(capacity, 1 << 20);
+    std::rotate(keys.begin(), keys.begin() + state.thread_index() * 4099, keys.end());
+    int hits = 0;
+    std::size_t i = 0;
+    for (auto _ : state) {
+        auto k = keys[i++ & (keys.size() - 1)];
+        if (cache->get(k) != -1) {
+            ++hits;
+        } else {
+            cache->put(k, k);
+        }
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_ShardedGetPut)->Arg(1)->Arg(64)
+    ->ThreadRange(1, static_cast<int>(std::max(1u, std::thread::hardware_concurrency())))->UseRealTime();
+
+// Read-heavy sharing: every thread replays the Zipf requests (from its own offset) against one cache
+// of 64K entries in 16 shards, a miss puts the key. Hit rates are high, so nearly every request is a hit:
+// a shard mutex for ShardedLRUCache, a shared lock and a reference bit for the CLOCK caches,
+// a thread-local L1 in front of the shards for FrontCache, a stripe lock and a buffered hit for
+// ConcurrentLFUCache (which isn't sharded).
+template<class Cache>
+std::unique_ptr<Cache> make_shared_cache(int shards, int capacity) {
+    if constexpr (std::is_constructible<Cache, std::size_t, std::size_t>::value) {
+        return std::make_unique<Cache>(shards, capacity / shards);
+    } else {
+        return std::make_unique<Cache>(capacity);
+    }
+}
+
+template<class Cache>
+void BM_ConcurrentReads(benchmark::State& state) {
+    static std::unique_ptr<Cache> cache;
+    const int capacity = 1 << 16;
+    const int shards = 16;
+    const auto& keys = zipf_keys(capacity);
+    if (state.thread_index() == 0) {
+        cache = make_shared_cache<Cache>(shards, capacity);
+        for (auto k : keys) {
+            if (cache->get(k) == -1) {
+                cache->put(k, k);
+            }
+        }
+    }
+    int64_t hits = 0;
+    std::size_t i = static_cast<std::size_t>(state.thread_index()) * 40961;
+    for (auto _ : state) {
+        auto k = keys[i++ & (keys.size() - 1)];
+        if (cache->get(k) != -1) {
+            ++hits;
+        } else {
+            cache->put(k, k);
+        }
+    }
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hit_rate"] = benchmark::Counter(static_cast<double>(hits) / state.iterations(),
+                                                    benchmark::Counter::kAvgThreads);
+}
+
+BENCHMARK_TEMPLATE(BM_ConcurrentReads, ShardedLRUCache<>)
+    ->ThreadRange(1, static_cast<int>(std::max(1u, std::thread::hardware_concurrency())))->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ConcurrentReads, ClockCache<>)
+    ->ThreadRange(1, static_cast<int>(std::max(1u, std::thread::hardware_concurrency())))->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ConcurrentReads, ClockProCache<>)
+    ->ThreadRange(1, static_cast<int>(std::max(1u, std::thread::hardware_concurrency())))->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ConcurrentReads, FrontCache<>)
+    ->ThreadRange(1, static_cast<int>(std::max(1u, std::thread::hardware_concurrency())))->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ConcurrentReads, ConcurrentLFUCache<>)
+    ->ThreadRange(1, static_cast<int>(std::max(1u, std::thread::hardware_concurrency())))->UseRealTime();
+
+// Policy suite: every policy on every workload for universes of 1K to 100M keys, the cache holds a tenth
+// of the keys. Reports ns/op, allocs_per_op and hit_rate after a warm-up that fills the cache.
+// Registered workload by workload, so only the current trace stays in memory. For regression tracking:
+//   caches_bench --benchmark_filter=BM_Policy --benchmark_out=<commit>.json --benchmark_out_format=json
+struct WorkloadSpec {
+    Workload workload;
+    double alpha;
+    std::string name;
+};
+
+const std::vector<WorkloadSpec> workload_specs = {
+    {Workload::zipf, 0.8, "zipf0.8"},
+    {Workload::zipf, 0.99, "zipf0.99"},
+    {Workload::scan, 0.99, "scan"},
+    {Workload::loop, 0.99, "loop"},
+    {Workload::mixed, 0.99, "mixed"}};
+
+const std::vector<int64_t> workload_keys = {1 << 10, 1 << 15, 1 << 20, 1 << 25, 100'000'000};
+
+std::size_t workload_capacity(int64_t keys) {
+    return static_cast<std::size_t>(std::max<int64_t>(keys / 10, 16));
+}
+
+// the first requests fill the cache (twice), as many more are measured: replaying them after
+// a full cache worth of other requests doesn't just hit the same entries again
+std::size_t warmup_length(int64_t keys) {
+    return std::max<std::size_t>(1 << 22, 2 * workload_capacity(keys));
+}
+
+const std::vector<int>& workload_trace(const WorkloadSpec& spec, int64_t keys) {
+    static std::string current_name;
+    static int64_t current_keys = 0;
+    static std::vector<int> trace;
+    if (current_name != spec.name || current_keys != keys) {
+        trace.clear();
+        trace.shrink_to_fit();
+        auto capacity = workload_capacity(keys);
+        trace = make_trace(spec.workload, static_cast<uint64_t>(keys), capacity, 2 * warmup_length(keys),
+                           spec.alpha);
+        current_name = spec.name;
+        current_keys = keys;
+    }
+    return trace;
+}
+
+template<class Cache, class... Args>
+void BM_Policy(benchmark::State& state, const WorkloadSpec& spec, Args... args) {
+    const auto keys = state.range(0);
+    const auto& trace = workload_trace(spec, keys);
+    const auto warmup = warmup_length(keys);
+    Cache cache(workload_capacity(keys), args...);
+    for (std::size_t i = 0; i < warmup; ++i) {
+        auto k = trace[i];
+        cache.access(k, [k] { return k; });
+    }
+    // the measured part is replayed again if the benchmark needs more iterations
+    int64_t hits = 0;
+    auto i = warmup;
+    auto allocations_before = allocations.load(std::memory_order_relaxed);
+    for (auto _ : state) {
+        auto k = trace[i];
+        if (++i == trace.size()) {
+            i = warmup;
+        }
+        if (cache.access(k, [k] { return k; }).second) {
+            ++hits;
+        }
+    }
+    auto allocated = allocations.load(std::memory_order_relaxed) - allocations_before;
+    benchmark::DoNotOptimize(hits);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hit_rate"] = static_cast<double>(hits) / state.iterations();
+    state.counters["allocs_per_op"] = static_cast<double>(allocated) / state.iterations();
+}
+
+template<class Cache, class... Args>
+void register_policy(const WorkloadSpec& spec, int64_t keys, const std::string& policy, Args... args) {
+    auto name = "BM_Policy/" + spec.name + "/" + policy;
+    benchmark::RegisterBenchmark(name.c_str(), [&spec, args...](benchmark::State& state) {
+        BM_Policy<Cache>(state, spec, args...);
+    })->Arg(keys);
+}
+
+void register_policy_suite() {
+    for (auto& spec : workload_specs) {
+        for (auto keys : workload_keys) {
+            register_policy<LRUCache<>>(spec, keys, "lru");
+            register_policy<LFUCache<>>(spec, keys, "lfu");
+            register_policy<LFUCache<>>(spec, keys, "lfu_da", LFUPolicy(LFUAging::dynamic));
+            register_policy<ARCCache<>>(spec, keys, "arc");
+            register_policy<TinyLFUCache<>>(spec, keys, "tinylfu");
+            register_policy<ClockCache<>>(spec, keys, "clock");
+            register_policy<ClockProCache<>>(spec, keys, "clockpro");
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    register_policy_suite();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
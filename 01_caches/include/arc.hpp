@@ -0,0 +1,204 @@
+#pragma once
+#include "slab.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// Adaptive Replacement Cache (Megiddo, Modha).
+// T1 keeps entries seen once recently, T2 entries seen at least twice, B1/B2 are ghost lists with
+// keys recently evicted from T1/T2. A ghost hit in B1 grows the target size p of T1, a ghost hit
+// in B2 shrinks it, so the cache balances recency and frequency on its own.
+// Resident entries and ghosts share one slab of 2 * capacity nodes.
+template<class K = int, class V = int, class Hash = std::hash<K>>
+class ARCCache {
+public:
+    static constexpr const char* name = "arc";
+
+    ARCCache() = default;
+    ARCCache(std::size_t capacity) : index(2 * capacity), capacity(capacity) {
+        check_slab_capacity(2 * capacity);
+        nodes.reserve(2 * capacity);
+    }
+
+    bool full() const;
+    std::size_t size() const { return t1.size() + t2.size(); }
+
+    // returns -1 (V{} for non-arithmetic values) on a miss, use find() to tell misses apart
+    V get(const K& key);
+    // returns pointer to the cached value or nullptr, ghost entries are misses
+    V* find(const K& key);
+    void put(const K& key, const V& value);
+    // finds the key or caches make_value() for it with a single index probe,
+    // returns the cached value (nullptr if capacity is 0) and whether it was a hit
+    template<class F>
+    std::pair<V*, bool> access(const K& key, F&& make_value);
+
+private:
+    enum class Where : uint8_t {
+        t1,
+        t2,
+        b1,
+        b2
+    };
+
+    struct Node {
+        K key;
+        V value;
+        SlabLinks links;
+        Where where;
+    };
+
+    uint32_t lookup(std::size_t bucket, const K& key) const {
+        return index.find_in(bucket, key, [this](uint32_t slot) -> const K& { return nodes[slot].key; });
+    }
+
+    bool resident(uint32_t slot) const {
+        return nodes[slot].where == Where::t1 || nodes[slot].where == Where::t2;
+    }
+
+    SlabList<Node>& list(Where where);
+    void move_to(uint32_t slot, Where where);
+    void replace(bool in_b2);
+    void drop_lru(Where where);
+    uint32_t allocate(const K& key, V&& value);
+
+    std::vector<Node> nodes;
+    SlabList<Node> t1, t2, b1, b2;
+    uint32_t free_slots = slab_npos;  // dropped ghosts chained through links.next
+    SlabIndex<K, Hash> index;
+    std::size_t capacity = 0;
+    std::size_t p = 0;  // target size of T1
+};
+
+template<class K, class V, class Hash>
+bool ARCCache<K, V, Hash>::full() const {
+    return capacity == size();
+}
+
+template<class K, class V, class Hash>
+V ARCCache<K, V, Hash>::get(const K& key) {
+    auto* value = find(key);
+    return value != nullptr ? *value : cache_miss_value<V>();
+}
+
+template<class K, class V, class Hash>
+V* ARCCache<K, V, Hash>::find(const K& key) {
+    auto slot = lookup(index.bucket(key), key);
+    if (slot == slab_npos || !resident(slot)) {
+        return nullptr;
+    }
+    move_to(slot, Where::t2);
+    return &nodes[slot].value;
+}
+
+template<class K, class V, class Hash>
+void ARCCache<K, V, Hash>::put(const K& key, const V& value) {
+    auto [cached, hit] = access(key, [&value] { return value; });
+    if (hit) {
+        *cached = value;
+    }
+}
+
+template<class K, class V, class Hash>
+template<class F>
+std::pair<V*, bool> ARCCache<K, V, Hash>::access(const K& key, F&& make_value) {
+    auto bucket = index.bucket(key);
+    auto slot = lookup(bucket, key);
+    if (slot != slab_npos && resident(slot)) {
+        move_to(slot, Where::t2);
+        return {&nodes[slot].value, true};
+    }
+    if (capacity == 0) {
+        return {nullptr, false};
+    }
+
+    if (slot != slab_npos) {
+        if (nodes[slot].where == Where::b1) {
+            p = std::min(capacity, p + std::max<std::size_t>(b2.size() / b1.size(), 1));
+            replace(false);
+        } else {
+            auto delta = std::max<std::size_t>(b1.size() / b2.size(), 1);
+            p = p > delta ? p - delta : 0;
+            replace(true);
+        }
+        move_to(slot, Where::t2);
+        nodes[slot].value = make_value();
+        return {&nodes[slot].value, false};
+    }
+
+    if (t1.size() + b1.size() == capacity) {
+        if (t1.size() < capacity) {
+            drop_lru(Where::b1);
+            replace(false);
+        } else {
+            drop_lru(Where::t1);
+        }
+    } else {
+        auto total = t1.size() + t2.size() + b1.size() + b2.size();
+        if (total >= capacity) {
+            if (total == 2 * capacity) {
+                drop_lru(Where::b2);
+            }
+            replace(false);
+        }
+    }
+    slot = allocate(key, make_value());
+    nodes[slot].where = Where::t1;
+    t1.push_front(nodes, slot);
+    index.insert_in(bucket, slot);
+    return {&nodes[slot].value, false};
+}
+
+template<class K, class V, class Hash>
+SlabList<typename ARCCache<K, V, Hash>::Node>& ARCCache<K, V, Hash>::list(Where where) {
+    switch (where) {
+        case Where::t1: return t1;
+        case Where::t2: return t2;
+        case Where::b1: return b1;
+        default: return b2;
+    }
+}
+
+template<class K, class V, class Hash>
+void ARCCache<K, V, Hash>::move_to(uint32_t slot, Where where) {
+    list(nodes[slot].where).unlink(nodes, slot);
+    nodes[slot].where = where;
+    list(where).push_front(nodes, slot);
+}
+
+// moves the LRU entry of T1 or T2 to the corresponding ghost list
+template<class K, class V, class Hash>
+void ARCCache<K, V, Hash>::replace(bool in_b2) {
+    if (!t1.empty() && (t2.empty() || (in_b2 && t1.size() == p) || t1.size() > p)) {
+        move_to(t1.back(), Where::b1);
+    } else {
+        move_to(t2.back(), Where::b2);
+    }
+}
+
+template<class K, class V, class Hash>
+void ARCCache<K, V, Hash>::drop_lru(Where where) {
+    auto& l = list(where);
+    auto slot = l.back();
+    l.unlink(nodes, slot);
+    index.erase(nodes[slot].key, slot);
+    nodes[slot].links.next = free_slots;
+    free_slots = slot;
+}
+
+template<class K, class V, class Hash>
+uint32_t ARCCache<K, V, Hash>::allocate(const K& key, V&& value) {
+    if (free_slots == slab_npos) {
+        nodes.push_back({key, std::move(value), {}, Where::t1});
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+    auto slot = free_slots;
+    free_slots = nodes[slot].links.next;
+    nodes[slot].key = key;
+    nodes[slot].value = std::move(value);
+    nodes[slot].links = {};
+    return slot;
+}
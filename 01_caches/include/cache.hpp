@@ -0,0 +1,293 @@
+#pragma once
+#include "cache_stats.hpp"
+#include "slab.hpp"
+#include "snapshot.hpp"
+#include "timing_wheel.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Slab cache shared by the eviction policies: `capacity` entries in a vector of slots that are handed out
+// while the cache warms up and reused on eviction afterwards, so steady-state get/put doesn't touch the heap.
+// IndexMap maps keys to slots: SlabIndex (chained) or FlatIndex (open addressing).
+//
+// Every entry has a weight (1 by default, e.g. the value size in bytes): with max_weight the cache
+// evicts until both the entry count fits `capacity` and the total weight fits max_weight.
+//
+// An entry put with a ttl expires once the clock (set_clock(), steady milliseconds by default) reaches
+// its deadline: every operation advances a timing wheel that removes the expired entries.
+//
+// save_snapshot()/load_snapshot() persist the entries in eviction order for a warm start (see snapshot.hpp).
+//
+// A removal listener sees every entry leaving the cache (evicted, expired or dropped by put()) before
+// its slot is reused, e.g. to write dirty values back (see WriteBackCache).
+//
+// EvictionPolicy decides which entry goes, it is a compile-time plug-in: no virtual calls, its
+// methods inline into the hot paths. A policy provides
+//   name                   - for reports and tests
+//   Hook                   - its per-entry state, the entry derives from it (an empty one costs nothing)
+//   Order<Entry>           - the eviction order over std::vector<Entry>, built from (policy, capacity):
+//     touch(entries, slot)            - a hit
+//     insert(entries, slot)           - a new entry
+//     victim(entries, keep)           - the entry to evict next, other than `keep`
+//     erase(entries, slot, evicted)   - the entry is removed (evicted or expired/dropped)
+//     before_lookup(), before_put(), missed() - trace-driven policies follow the requests (OrderDefaults)
+// and, to support snapshots, snapshot_kind and in Order:
+//     visit(entries, f)               - f(slot, freq, priority) from the entry evicted last to the next victim
+//     append(entries, slot, freq, priority) - restores an entry after the ones visited before it
+//     age(), set_age(age)
+// Entries link through their `links` member (free entries too), so list-based policies use SlabList<Entry>.
+
+// No-op request hooks and age for the policies that don't need them.
+struct OrderDefaults {
+    void before_lookup() {}
+    void before_put() {}
+    void missed() {}
+    uint64_t age() const { return 0; }
+    void set_age(uint64_t) {}
+};
+
+template<class K, class V, class EvictionPolicy, class IndexMap = SlabIndex<K>>
+class Cache {
+public:
+    static constexpr const char* name = EvictionPolicy::name;
+
+    Cache() = default;
+    Cache(std::size_t capacity, uint64_t max_weight = unbounded_weight) :
+        Cache(capacity, EvictionPolicy{}, max_weight) {}
+    Cache(std::size_t capacity, EvictionPolicy policy, uint64_t max_weight = unbounded_weight) :
+        order(std::move(policy), capacity), index(capacity), wheel(capacity), capacity(capacity),
+        max_weight(max_weight) {
+        check_slab_capacity(capacity);
+        entries.reserve(capacity);
+    }
+
+    bool full() const { return count == capacity; }
+    std::size_t size() const { return count; }
+    uint64_t weight() const { return total_weight; }
+    // hits and misses of access()
+    const CacheStats& stats() const { return statistics; }
+    void set_clock(CacheClock new_clock) { clock = std::move(new_clock); }
+    using RemovalListener = std::function<void(const K& key, V& value)>;
+    void set_removal_listener(RemovalListener listener) { on_removal = std::move(listener); }
+    // sizes the index for the keys 0..universe-1 up front, for indexes that have reserve() (DenseIndex)
+    void reserve_index(std::size_t universe) { index.reserve(universe); }
+
+    // returns -1 (V{} for non-arithmetic values) on a miss, use find() to tell misses apart
+    V get(const K& key);
+    // returns pointer to the cached value or nullptr, a hit is reported to the policy
+    V* find(const K& key);
+    // a value heavier than max_weight isn't cached (and drops the cached one),
+    // the ttl replaces the one of the cached entry
+    void put(const K& key, const V& value, uint32_t weight = 1, uint64_t ttl = no_ttl);
+    // finds the key or caches make_value() of the given weight and ttl for it with a single index probe,
+    // returns the cached value (nullptr if it wasn't cached) and whether it was a hit
+    template<class F>
+    std::pair<V*, bool> access(const K& key, F&& make_value, uint32_t weight = 1, uint64_t ttl = no_ttl);
+
+    // f(key, value) for every entry from the one evicted last, without reporting hits to the policy;
+    // expired entries are removed first
+    template<class F>
+    void for_each(F&& f) {
+        expire();
+        order.visit(entries, [this, &f](uint32_t slot, uint64_t, uint64_t) { f(entries[slot].key, entries[slot].value); });
+    }
+
+    // writes the entries from the one evicted last, expired entries are removed first
+    void save_snapshot(const std::string& path);
+    // fills an empty cache with the snapshot entries evicted last that fit into it
+    void load_snapshot(const std::string& path);
+
+private:
+    struct Entry : EvictionPolicy::Hook {
+        K key;
+        V value;
+        SlabLinks links;
+        uint32_t weight;
+    };
+
+    uint32_t lookup(std::size_t bucket, const K& key) const {
+        return index.find_in(bucket, key, [this](uint32_t slot) -> const K& { return entries[slot].key; });
+    }
+
+    template<class F>
+    std::pair<uint32_t, bool> find_or_insert(const K& key, F&& make_value, uint32_t weight, uint64_t ttl);
+    template<class F>
+    uint32_t allocate(const K& key, F&& make_value, uint32_t weight);
+    void remove(uint32_t slot, bool evicted);
+
+    // removes the expired entries, with force the wheel catches up with the clock even without timers
+    void expire(bool force = false) {
+        if (force || !wheel.empty()) {
+            wheel.advance(clock(), [this](uint32_t slot) { remove(slot, false); });
+        }
+    }
+
+    uint64_t deadline(uint64_t ttl) const {
+        return ttl < no_ttl - wheel.now() ? wheel.now() + ttl : no_ttl;
+    }
+
+    std::vector<Entry> entries;
+    typename EvictionPolicy::template Order<Entry> order;
+    uint32_t free_slots = slab_npos;  // removed entries chained through links.next
+    IndexMap index;
+    TimingWheel wheel;
+    CacheClock clock = steady_clock_ms;
+    RemovalListener on_removal;
+    std::size_t capacity = 0;
+    std::size_t count = 0;
+    uint64_t max_weight = unbounded_weight;
+    uint64_t total_weight = 0;
+    CacheStats statistics;
+};
+
+template<class K, class V, class EvictionPolicy, class IndexMap>
+V Cache<K, V, EvictionPolicy, IndexMap>::get(const K& key) {
+    auto* value = find(key);
+    return value != nullptr ? *value : cache_miss_value<V>();
+}
+
+template<class K, class V, class EvictionPolicy, class IndexMap>
+V* Cache<K, V, EvictionPolicy, IndexMap>::find(const K& key) {
+    expire();
+    order.before_lookup();
+    auto slot = lookup(index.bucket(key), key);
+    if (slot == slab_npos) {
+        order.missed();
+        return nullptr;
+    }
+    order.touch(entries, slot);
+    return &entries[slot].value;
+}
+
+template<class K, class V, class EvictionPolicy, class IndexMap>
+void Cache<K, V, EvictionPolicy, IndexMap>::put(const K& key, const V& value, uint32_t weight, uint64_t ttl) {
+    order.before_put();
+    auto [slot, hit] = find_or_insert(key, [&value] { return value; }, weight, ttl);
+    if (!hit) {
+        return;
+    }
+    if (weight > max_weight) {
+        remove(slot, false);
+        return;
+    }
+    wheel.cancel(slot);
+    if (ttl != no_ttl) {
+        wheel.schedule(slot, deadline(ttl));
+    }
+    entries[slot].value = value;
+    total_weight = total_weight - entries[slot].weight + weight;
+    entries[slot].weight = weight;
+    // the updated entry is never evicted for its own update
+    while (total_weight > max_weight) {
+        remove(order.victim(entries, slot), true);
+    }
+}
+
+template<class K, class V, class EvictionPolicy, class IndexMap>
+template<class F>
+std::pair<V*, bool> Cache<K, V, EvictionPolicy, IndexMap>::access(const K& key, F&& make_value, uint32_t weight,
+    uint64_t ttl) {
+    order.before_lookup();
+    auto [slot, hit] = find_or_insert(key, make_value, weight, ttl);
+    statistics.record(hit, hit ? entries[slot].weight : weight);
+    return {slot != slab_npos ? &entries[slot].value : nullptr, hit};
+}
+
+template<class K, class V, class EvictionPolicy, class IndexMap>
+template<class F>
+std::pair<uint32_t, bool> Cache<K, V, EvictionPolicy, IndexMap>::find_or_insert(const K& key, F&& make_value,
+    uint32_t weight, uint64_t ttl) {
+    expire(ttl != no_ttl);
+    auto bucket = index.bucket(key);
+    auto slot = lookup(bucket, key);
+    if (slot != slab_npos) {
+        order.touch(entries, slot);
+        return {slot, true};
+    }
+    if (capacity == 0 || weight > max_weight) {
+        return {slab_npos, false};
+    }
+
+    while (full() || total_weight + weight > max_weight) {
+        remove(order.victim(entries, slab_npos), true);
+    }
+    slot = allocate(key, make_value, weight);
+    order.insert(entries, slot);
+    index.insert_in(bucket, slot);
+    if (ttl != no_ttl) {
+        wheel.schedule(slot, deadline(ttl));
+    }
+    return {slot, false};
+}
+
+// a free entry for the new key, the caller passes it to the policy and indexes it
+template<class K, class V, class EvictionPolicy, class IndexMap>
+template<class F>
+uint32_t Cache<K, V, EvictionPolicy, IndexMap>::allocate(const K& key, F&& make_value, uint32_t weight) {
+    uint32_t slot;
+    if (free_slots != slab_npos) {
+        slot = free_slots;
+        free_slots = entries[slot].links.next;
+        entries[slot].key = key;
+        entries[slot].value = make_value();
+        entries[slot].weight = weight;
+    } else {
+        slot = static_cast<uint32_t>(entries.size());
+        entries.push_back({{}, key, make_value(), {}, weight});
+    }
+    ++count;
+    total_weight += weight;
+    return slot;
+}
+
+template<class K, class V, class EvictionPolicy, class IndexMap>
+void Cache<K, V, EvictionPolicy, IndexMap>::remove(uint32_t slot, bool evicted) {
+    if (on_removal) {
+        on_removal(entries[slot].key, entries[slot].value);
+    }
+    wheel.cancel(slot);
+    order.erase(entries, slot, evicted);
+    index.erase(entries[slot].key, slot);
+    --count;
+    total_weight -= entries[slot].weight;
+    entries[slot].links.next = free_slots;
+    free_slots = slot;
+}
+
+template<class K, class V, class EvictionPolicy, class IndexMap>
+void Cache<K, V, EvictionPolicy, IndexMap>::save_snapshot(const std::string& path) {
+    expire();
+    SnapshotWriter<K, V> snapshot(path, EvictionPolicy::snapshot_kind, size(), order.age());
+    order.visit(entries, [this, &snapshot](uint32_t slot, uint64_t freq, uint64_t priority) {
+        auto& entry = entries[slot];
+        snapshot.write({index.hash(entry.key), freq, priority, entry.key, entry.value, entry.weight});
+    });
+    snapshot.finish();
+}
+
+template<class K, class V, class EvictionPolicy, class IndexMap>
+void Cache<K, V, EvictionPolicy, IndexMap>::load_snapshot(const std::string& path) {
+    if (size() != 0) {
+        throw std::logic_error("Snapshot can only be loaded into an empty cache");
+    }
+    SnapshotReader<K, V> snapshot(path, EvictionPolicy::snapshot_kind);
+    if (snapshot.size() != 0 && snapshot[0].hash != index.hash(snapshot[0].key)) {
+        throw std::runtime_error("Snapshot was written with a different hash function");
+    }
+    // appended in snapshot order, the entries that would be evicted first are the ones left out
+    for (std::size_t i = 0; i < snapshot.size() && !full(); ++i) {
+        auto record = snapshot[i];
+        if (total_weight + record.weight > max_weight) {
+            break;
+        }
+        auto slot = allocate(record.key, [&record] { return record.value; }, record.weight);
+        order.append(entries, slot, record.freq, record.priority);
+        index.insert_in(index.bucket_of(record.hash), slot);
+    }
+    order.set_age(snapshot.age());
+}
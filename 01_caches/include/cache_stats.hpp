@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+
+// Weight limit of a cache without a byte budget.
+constexpr uint64_t unbounded_weight = std::numeric_limits<uint64_t>::max();
+
+// Hits and misses counted both per request (object hits) and per weight unit (byte hits).
+// With the default weight of 1 both ratios are the same.
+struct CacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t hit_weight = 0;
+    uint64_t miss_weight = 0;
+
+    void record(bool hit, uint64_t weight) {
+        if (hit) {
+            ++hits;
+            hit_weight += weight;
+        } else {
+            ++misses;
+            miss_weight += weight;
+        }
+    }
+
+    double hit_ratio() const {
+        return hits + misses != 0 ? static_cast<double>(hits) / (hits + misses) : 0;
+    }
+
+    double byte_hit_ratio() const {
+        return hit_weight + miss_weight != 0 ? static_cast<double>(hit_weight) / (hit_weight + miss_weight) : 0;
+    }
+};
@@ -0,0 +1,163 @@
+#pragma once
+#include "sharding.hpp"
+#include "slab.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+// Thread-safe CLOCK (second chance) cache: an LRU approximation whose hits don't reorder anything.
+// Every shard keeps its entries in a flat array with a reference bit each. A hit takes the shard lock
+// shared and only sets the bit with a relaxed atomic store, so readers never wait for each other.
+// A miss takes the lock exclusively: the hand sweeps the array clearing set bits and evicts the first
+// entry whose bit is clear. The shard is picked by key hash like in ShardedLRUCache.
+template<class K = int, class V = int, class Hash = std::hash<K>>
+class ClockCache {
+public:
+    static constexpr const char* name = "clock";
+
+    ClockCache(std::size_t shards_count, std::size_t shard_capacity);
+    // a single shard, for replays
+    explicit ClockCache(std::size_t capacity) : ClockCache(1, capacity) {}
+
+    std::size_t shards_count() const { return shards.size(); }
+    std::size_t size() const;
+
+    // returns -1 (V{} for non-arithmetic values) on a miss like LRUCache::get
+    V get(const K& key);
+    std::optional<V> find(const K& key);
+    void put(const K& key, const V& value);
+
+    // the cached value, or make_value() cached on a miss; .second tells whether it was a hit
+    template<class F>
+    std::pair<V, bool> access(const K& key, F&& make_value);
+
+private:
+    struct Entry {
+        K key;
+        V value;
+        std::atomic<uint8_t> referenced{0};
+    };
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        SlabIndex<K, Hash> index;
+        std::vector<Entry> entries;
+        uint32_t used = 0;
+        uint32_t hand = 0;
+    };
+
+    Shard& shard(const K& key) { return pick_shard(shards, hasher, key); }
+
+    // the slot of the key with the shard lock held (shared or exclusive)
+    static uint32_t lookup(const Shard& s, const K& key) {
+        return s.index.find(key, [&s](uint32_t slot) -> const K& { return s.entries[slot].key; });
+    }
+
+    // with the shard lock held exclusively
+    void insert(Shard& s, const K& key, const V& value);
+
+    std::vector<Shard> shards;
+    Hash hasher;
+};
+
+template<class K, class V, class Hash>
+ClockCache<K, V, Hash>::ClockCache(std::size_t shards_count, std::size_t shard_capacity)
+    : shards(make_shards<Shard>(shards_count)) {
+    check_slab_capacity(shard_capacity);
+    for (auto& s : shards) {
+        s.index = SlabIndex<K, Hash>(shard_capacity);
+        s.entries = std::vector<Entry>(shard_capacity);
+    }
+}
+
+template<class K, class V, class Hash>
+std::size_t ClockCache<K, V, Hash>::size() const {
+    std::size_t total = 0;
+    for (auto& s : shards) {
+        std::shared_lock<std::shared_mutex> lock(s.mutex);
+        total += s.used;
+    }
+    return total;
+}
+
+template<class K, class V, class Hash>
+V ClockCache<K, V, Hash>::get(const K& key) {
+    auto value = find(key);
+    return value ? *value : cache_miss_value<V>();
+}
+
+template<class K, class V, class Hash>
+std::optional<V> ClockCache<K, V, Hash>::find(const K& key) {
+    auto& s = shard(key);
+    std::shared_lock<std::shared_mutex> lock(s.mutex);
+    auto slot = lookup(s, key);
+    if (slot == slab_npos) {
+        return std::nullopt;
+    }
+    set_referenced(s.entries[slot].referenced);
+    return s.entries[slot].value;
+}
+
+template<class K, class V, class Hash>
+void ClockCache<K, V, Hash>::put(const K& key, const V& value) {
+    auto& s = shard(key);
+    std::lock_guard<std::shared_mutex> lock(s.mutex);
+    auto slot = lookup(s, key);
+    if (slot != slab_npos) {
+        s.entries[slot].value = value;
+        set_referenced(s.entries[slot].referenced);
+        return;
+    }
+    insert(s, key, value);
+}
+
+template<class K, class V, class Hash>
+template<class F>
+std::pair<V, bool> ClockCache<K, V, Hash>::access(const K& key, F&& make_value) {
+    if (auto value = find(key)) {
+        return {std::move(*value), true};
+    }
+    auto& s = shard(key);
+    std::lock_guard<std::shared_mutex> lock(s.mutex);
+    // another thread may have cached it between the locks
+    auto slot = lookup(s, key);
+    if (slot != slab_npos) {
+        set_referenced(s.entries[slot].referenced);
+        return {s.entries[slot].value, true};
+    }
+    V value = make_value();
+    insert(s, key, value);
+    return {std::move(value), false};
+}
+
+template<class K, class V, class Hash>
+void ClockCache<K, V, Hash>::insert(Shard& s, const K& key, const V& value) {
+    auto capacity = static_cast<uint32_t>(s.entries.size());
+    if (capacity == 0) {
+        return;
+    }
+    uint32_t slot;
+    if (s.used < capacity) {
+        slot = s.used++;
+    } else {
+        // every entry gets a second chance, so the sweep ends within one round
+        while (s.entries[s.hand].referenced.load(std::memory_order_relaxed) != 0) {
+            s.entries[s.hand].referenced.store(0, std::memory_order_relaxed);
+            s.hand = s.hand + 1 == capacity ? 0 : s.hand + 1;
+        }
+        slot = s.hand;
+        s.hand = s.hand + 1 == capacity ? 0 : s.hand + 1;
+        s.index.erase(s.entries[slot].key, slot);
+    }
+    auto& e = s.entries[slot];
+    e.key = key;
+    e.value = value;
+    e.referenced.store(0, std::memory_order_relaxed);
+    s.index.insert(key, slot);
+}
@@ -0,0 +1,386 @@
+#pragma once
+#include "sharding.hpp"
+#include "slab.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <utility>
+#include <vector>
+
+// Thread-safe CLOCK-Pro (Jiang, Chen, Zhang, USENIX ATC 2005): a CLOCK that tells hot pages from cold ones
+// by their reuse distance, so scans and loops don't flush the hot set (an approximation of LIRS).
+// Resident pages are hot or cold. A new page starts cold, in its test period, which lasts until the page
+// is older than every hot page. Three hands sweep one circular list of pages, oldest first:
+//   the cold hand  on a miss in a full shard, handles cold pages until it evicts one: a cold page
+//                  referenced in its test period turns hot, one referenced after it gets a new test
+//                  period, an unreferenced one is evicted and, if still in its test period, stays on
+//                  the clock as a non-resident page (key only); a miss on that key readmits it as hot;
+//   the hot hand   demotes unreferenced hot pages to cold while there are more hot pages than the
+//                  capacity minus the cold target, and ends the test periods of the cold pages it passes
+//                  (non-resident ones leave the clock);
+//   the test hand  does the same to cold pages while more than `capacity` pages are non-resident.
+// The cold target adapts within 1..capacity: an access in a test period grows it, a test period that
+// ends without one shrinks it. It starts at the capacity, so a shard starts as a plain CLOCK.
+// Departure from the paper: each hand runs until its one task is done instead of stopping at the
+// next page of its kind, which only changes where it rests between runs.
+//
+// Like ClockCache a hit only sets the reference bit with a relaxed atomic store under the shared
+// shard lock, everything else runs under the exclusive one. Pages (resident and non-resident, at most
+// 2 * capacity) live in a flat array linked into the circle by slot numbers.
+template<class K = int, class V = int, class Hash = std::hash<K>>
+class ClockProCache {
+public:
+    static constexpr const char* name = "clockpro";
+
+    ClockProCache(std::size_t shards_count, std::size_t shard_capacity);
+    // a single shard, for replays
+    explicit ClockProCache(std::size_t capacity) : ClockProCache(1, capacity) {}
+
+    std::size_t shards_count() const { return shards.size(); }
+    // resident entries
+    std::size_t size() const;
+
+    // returns -1 (V{} for non-arithmetic values) on a miss like LRUCache::get
+    V get(const K& key);
+    std::optional<V> find(const K& key);
+    void put(const K& key, const V& value);
+
+    // the cached value, or make_value() cached on a miss; .second tells whether it was a hit
+    template<class F>
+    std::pair<V, bool> access(const K& key, F&& make_value);
+
+private:
+    enum class PageType : uint8_t {
+        hot,
+        cold,
+        test  // non-resident, in its test period
+    };
+
+    struct Entry {
+        K key;
+        V value;
+        uint32_t prev = slab_npos;
+        uint32_t next = slab_npos;  // the free list too
+        PageType type = PageType::cold;
+        bool test_period = false;  // of a resident cold page
+        std::atomic<uint8_t> referenced{0};
+    };
+
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        SlabIndex<K, Hash> index;
+        std::vector<Entry> entries;
+        uint32_t free = slab_npos;
+        uint32_t hand_hot = slab_npos;
+        uint32_t hand_cold = slab_npos;
+        uint32_t hand_test = slab_npos;
+        std::size_t capacity = 0;
+        std::size_t cold_target = 0;
+        std::size_t count_hot = 0;
+        std::size_t count_cold = 0;
+        std::size_t count_test = 0;
+    };
+
+    Shard& shard(const K& key) { return pick_shard(shards, hasher, key); }
+
+    // the slot of the key (resident or test) with the shard lock held
+    static uint32_t lookup(const Shard& s, const K& key) {
+        return s.index.find(key, [&s](uint32_t slot) -> const K& { return s.entries[slot].key; });
+    }
+
+    static bool resident(const Shard& s, uint32_t slot) {
+        return slot != slab_npos && s.entries[slot].type != PageType::test;
+    }
+
+    // with the shard lock held exclusively: caches a missing key or readmits a non-resident one
+    static void admit(Shard& s, uint32_t slot, const K& key, const V& value);
+    static void link(Shard& s, uint32_t slot);
+    static void unlink(Shard& s, uint32_t slot);
+    static void release(Shard& s, uint32_t slot);
+    static void end_test_period(Shard& s, uint32_t slot);
+    static void balance_hot(Shard& s);
+    // every hand run does one task: evicts a cold page, demotes a hot page or drops a non-resident page
+    static void run_hand_cold(Shard& s);
+    static void run_hand_hot(Shard& s);
+    static void run_hand_test(Shard& s);
+
+    std::vector<Shard> shards;
+    Hash hasher;
+};
+
+template<class K, class V, class Hash>
+ClockProCache<K, V, Hash>::ClockProCache(std::size_t shards_count, std::size_t shard_capacity)
+    : shards(make_shards<Shard>(shards_count)) {
+    check_slab_capacity(2 * shard_capacity);
+    for (auto& s : shards) {
+        // resident entries and as many test ones, plus the one being admitted
+        auto slots = 2 * shard_capacity + 1;
+        s.index = SlabIndex<K, Hash>(slots);
+        s.entries = std::vector<Entry>(slots);
+        for (auto slot = static_cast<uint32_t>(slots); slot-- > 0;) {
+            s.entries[slot].next = s.free;
+            s.free = slot;
+        }
+        s.capacity = shard_capacity;
+        s.cold_target = shard_capacity;
+    }
+}
+
+template<class K, class V, class Hash>
+std::size_t ClockProCache<K, V, Hash>::size() const {
+    std::size_t total = 0;
+    for (auto& s : shards) {
+        std::shared_lock<std::shared_mutex> lock(s.mutex);
+        total += s.count_hot + s.count_cold;
+    }
+    return total;
+}
+
+template<class K, class V, class Hash>
+V ClockProCache<K, V, Hash>::get(const K& key) {
+    auto value = find(key);
+    return value ? *value : cache_miss_value<V>();
+}
+
+template<class K, class V, class Hash>
+std::optional<V> ClockProCache<K, V, Hash>::find(const K& key) {
+    auto& s = shard(key);
+    std::shared_lock<std::shared_mutex> lock(s.mutex);
+    auto slot = lookup(s, key);
+    if (!resident(s, slot)) {
+        return std::nullopt;
+    }
+    set_referenced(s.entries[slot].referenced);
+    return s.entries[slot].value;
+}
+
+template<class K, class V, class Hash>
+void ClockProCache<K, V, Hash>::put(const K& key, const V& value) {
+    auto& s = shard(key);
+    std::lock_guard<std::shared_mutex> lock(s.mutex);
+    auto slot = lookup(s, key);
+    if (resident(s, slot)) {
+        s.entries[slot].value = value;
+        set_referenced(s.entries[slot].referenced);
+        return;
+    }
+    admit(s, slot, key, value);
+}
+
+template<class K, class V, class Hash>
+template<class F>
+std::pair<V, bool> ClockProCache<K, V, Hash>::access(const K& key, F&& make_value) {
+    if (auto value = find(key)) {
+        return {std::move(*value), true};
+    }
+    auto& s = shard(key);
+    std::lock_guard<std::shared_mutex> lock(s.mutex);
+    // another thread may have cached it between the locks
+    auto slot = lookup(s, key);
+    if (resident(s, slot)) {
+        set_referenced(s.entries[slot].referenced);
+        return {s.entries[slot].value, true};
+    }
+    V value = make_value();
+    admit(s, slot, key, value);
+    return {std::move(value), false};
+}
+
+template<class K, class V, class Hash>
+void ClockProCache<K, V, Hash>::admit(Shard& s, uint32_t slot, const K& key, const V& value) {
+    if (s.capacity == 0) {
+        return;
+    }
+    bool full = s.count_hot + s.count_cold == s.capacity;
+    if (slot != slab_npos) {
+        // accessed in its test period: its reuse distance is shorter than the oldest hot page's
+        if (s.cold_target < s.capacity) {
+            ++s.cold_target;
+        }
+        // off the clock while the cold hand runs, the slot stays in the index
+        unlink(s, slot);
+        --s.count_test;
+        if (full) {
+            run_hand_cold(s);
+        }
+        auto& e = s.entries[slot];
+        e.value = value;
+        e.type = PageType::hot;
+        e.test_period = false;
+        e.referenced.store(0, std::memory_order_relaxed);
+        link(s, slot);
+        ++s.count_hot;
+        balance_hot(s);
+        return;
+    }
+    if (full) {
+        run_hand_cold(s);
+    }
+    slot = s.free;
+    s.free = s.entries[slot].next;
+    auto& e = s.entries[slot];
+    e.key = key;
+    e.value = value;
+    e.type = PageType::cold;
+    e.test_period = true;
+    e.referenced.store(0, std::memory_order_relaxed);
+    s.index.insert(key, slot);
+    link(s, slot);
+    ++s.count_cold;
+}
+
+// the list head is right behind the hot hand: the page is the newest, the last every hand reaches
+template<class K, class V, class Hash>
+void ClockProCache<K, V, Hash>::link(Shard& s, uint32_t slot) {
+    auto& e = s.entries[slot];
+    if (s.hand_hot == slab_npos) {
+        e.prev = e.next = slot;
+        s.hand_hot = s.hand_cold = s.hand_test = slot;
+        return;
+    }
+    auto next = s.hand_hot;
+    auto prev = s.entries[next].prev;
+    e.prev = prev;
+    e.next = next;
+    s.entries[prev].next = slot;
+    s.entries[next].prev = slot;
+}
+
+// a hand points at the next page it handles, so hands on the page move on to the following one
+template<class K, class V, class Hash>
+void ClockProCache<K, V, Hash>::unlink(Shard& s, uint32_t slot) {
+    auto& e = s.entries[slot];
+    auto next = e.next == slot ? slab_npos : e.next;
+    for (auto* hand : {&s.hand_hot, &s.hand_cold, &s.hand_test}) {
+        if (*hand == slot) {
+            *hand = next;
+        }
+    }
+    if (next != slab_npos) {
+        s.entries[e.prev].next = next;
+        s.entries[next].prev = e.prev;
+    }
+    e.prev = e.next = slab_npos;
+}
+
+// the page leaves the clock and the index
+template<class K, class V, class Hash>
+void ClockProCache<K, V, Hash>::release(Shard& s, uint32_t slot) {
+    unlink(s, slot);
+    s.index.erase(s.entries[slot].key, slot);
+    s.entries[slot].value = V();
+    s.entries[slot].next = s.free;
+    s.free = slot;
+}
+
+// a cold page's test period is over without an access: the cold pages get less room
+template<class K, class V, class Hash>
+void ClockProCache<K, V, Hash>::end_test_period(Shard& s, uint32_t slot) {
+    auto& e = s.entries[slot];
+    if (e.type == PageType::test) {
+        release(s, slot);
+        --s.count_test;
+    } else if (e.type == PageType::cold && e.test_period) {
+        e.test_period = false;
+    } else {
+        return;
+    }
+    if (s.cold_target > 1) {
+        --s.cold_target;
+    }
+}
+
+template<class K, class V, class Hash>
+void ClockProCache<K, V, Hash>::balance_hot(Shard& s) {
+    while (s.count_hot > s.capacity - s.cold_target) {
+        run_hand_hot(s);
+    }
+}
+
+// Runs with a full shard, so at least cold_target >= 1 resident pages are cold (balance_hot() keeps the
+// hot ones within capacity - cold_target). A referenced cold page has its bit cleared here and no hit
+// can set it again before the run ends (hits need the shared lock), the pages demoted on the way are
+// unreferenced: every cold page reached a second time is evicted, so the run ends within two sweeps.
+template<class K, class V, class Hash>
+void ClockProCache<K, V, Hash>::run_hand_cold(Shard& s) {
+    while (true) {
+        auto slot = s.hand_cold;
+        s.hand_cold = s.entries[slot].next;
+        auto& e = s.entries[slot];
+        if (e.type != PageType::cold) {
+            continue;
+        }
+        if (e.referenced.load(std::memory_order_relaxed) != 0) {
+            e.referenced.store(0, std::memory_order_relaxed);
+            if (e.test_period) {
+                e.type = PageType::hot;
+                e.test_period = false;
+                --s.count_cold;
+                ++s.count_hot;
+                if (s.cold_target < s.capacity) {
+                    ++s.cold_target;
+                }
+            } else {
+                e.test_period = true;
+            }
+            unlink(s, slot);
+            link(s, slot);
+            balance_hot(s);
+            continue;
+        }
+        --s.count_cold;
+        if (!e.test_period) {
+            release(s, slot);
+            return;
+        }
+        e.type = PageType::test;
+        e.value = V();
+        ++s.count_test;
+        while (s.count_test > s.capacity) {
+            run_hand_test(s);
+        }
+        return;
+    }
+}
+
+// Runs while there are more hot pages than the hot target, so there is one: the first sweep clears
+// its reference bit if set, the second demotes it at the latest.
+template<class K, class V, class Hash>
+void ClockProCache<K, V, Hash>::run_hand_hot(Shard& s) {
+    while (true) {
+        auto slot = s.hand_hot;
+        s.hand_hot = s.entries[slot].next;
+        auto& e = s.entries[slot];
+        if (e.type != PageType::hot) {
+            // older than every hot page left behind the hand
+            end_test_period(s, slot);
+            continue;
+        }
+        if (e.referenced.load(std::memory_order_relaxed) != 0) {
+            e.referenced.store(0, std::memory_order_relaxed);
+            continue;
+        }
+        e.type = PageType::cold;
+        --s.count_hot;
+        ++s.count_cold;
+        return;
+    }
+}
+
+// Runs while more than `capacity` pages are non-resident: it drops one within a sweep.
+template<class K, class V, class Hash>
+void ClockProCache<K, V, Hash>::run_hand_test(Shard& s) {
+    while (true) {
+        auto slot = s.hand_test;
+        s.hand_test = s.entries[slot].next;
+        bool non_resident = s.entries[slot].type == PageType::test;
+        end_test_period(s, slot);
+        if (non_resident) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,290 @@
+#pragma once
+#include "lfu.hpp"
+#include "slab.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Lossy bounded multi-producer single-consumer ring of 64-bit events (Vyukov's per-cell sequence numbers):
+// offer() never waits, an event that doesn't fit is dropped. The consumer has to be serialised by the caller.
+class ReadBuffer {
+public:
+    static constexpr uint64_t size = 64;
+
+    ReadBuffer() {
+        for (uint64_t i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool offer(uint64_t event) {
+        auto pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            auto& cell = cells[pos & (size - 1)];
+            auto diff = static_cast<int64_t>(cell.sequence.load(std::memory_order_acquire) - pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.event = event;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // events offered and not drained yet (approximately, while producers run)
+    uint64_t pending() const {
+        return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed);
+    }
+
+    template<class F>
+    void drain(F&& f) {
+        auto pos = head.load(std::memory_order_relaxed);
+        while (true) {
+            auto& cell = cells[pos & (size - 1)];
+            if (cell.sequence.load(std::memory_order_acquire) != pos + 1) {
+                break;
+            }
+            f(cell.event);
+            cell.sequence.store(pos + size, std::memory_order_release);
+            ++pos;
+        }
+        head.store(pos, std::memory_order_relaxed);
+    }
+
+private:
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        uint64_t event;
+    };
+
+    alignas(64) std::atomic<uint64_t> tail{0};
+    alignas(64) std::atomic<uint64_t> head{0};
+    Cell cells[size];
+};
+
+inline std::size_t next_thread_stripe() {
+    static std::atomic<std::size_t> next{0};
+    return next++;
+}
+
+// Concurrent LFU (optionally LFU-DA) that keeps policy bookkeeping off the hit path, as Caffeine does.
+// The entries and their index are guarded by striped reader-writer locks: a reader takes the shared lock
+// of its thread's stripe only, so readers on different threads don't touch each other's lock lines.
+// A hit copies the value and appends (slot, generation) to its stripe's ReadBuffer; the thread that
+// fills a buffer to half tries the drain lock and, if it gets it, replays the buffered hits of all stripes
+// into the LFU order (a thread that doesn't get it just goes on). Buffered hits whose slot was reused
+// since are skipped, hits that don't fit into a full buffer are lost: frequencies are approximate
+// under contention, exact for a single thread.
+//
+// Writes take the drain lock, replay the buffers (so eviction sees the frequencies) and lock every stripe
+// exclusively to change the entries: the cache is meant for read-mostly loads.
+template<class K = int, class V = int, class Hash = std::hash<K>>
+class ConcurrentLFUCache {
+public:
+    static constexpr const char* name = "concurrent_lfu";
+
+    ConcurrentLFUCache(std::size_t capacity, LFUAging aging = LFUAging::none,
+        std::size_t stripes_count = std::thread::hardware_concurrency());
+
+    std::size_t size() const;
+
+    // returns -1 (V{} for non-arithmetic values) on a miss like LRUCache::get
+    V get(const K& key);
+    std::optional<V> find(const K& key);
+    void put(const K& key, const V& value);
+
+    // the cached value, or make_value() cached on a miss; .second tells whether it was a hit
+    template<class F>
+    std::pair<V, bool> access(const K& key, F&& make_value);
+
+private:
+    struct Entry {
+        K key;
+        V value;
+        uint32_t generation;  // changes whenever the slot gets another key
+    };
+
+    struct Node : LFUPolicy::Hook {
+        SlabLinks links;
+    };
+
+    struct alignas(64) Stripe {
+        mutable std::shared_mutex lock;
+        ReadBuffer buffer;
+    };
+
+    // every stripe locked exclusively, in order
+    class WriteLock {
+    public:
+        explicit WriteLock(std::vector<Stripe>& stripes) : stripes(stripes) {
+            for (auto& s : stripes) {
+                s.lock.lock();
+            }
+        }
+        ~WriteLock() {
+            for (auto& s : stripes) {
+                s.lock.unlock();
+            }
+        }
+
+    private:
+        std::vector<Stripe>& stripes;
+    };
+
+    Stripe& stripe() {
+        thread_local const std::size_t thread_stripe = next_thread_stripe();
+        return stripes[thread_stripe % stripes.size()];
+    }
+
+    uint32_t lookup(const K& key) const {
+        return index.find(key, [this](uint32_t slot) -> const K& { return entries[slot].key; });
+    }
+
+    // the hit is buffered, a half-full buffer is drained if nobody else is draining
+    void record(Stripe& s, uint32_t slot, uint32_t generation);
+    // with the drain lock held
+    void drain();
+    void insert(const K& key, const V& value);
+
+    std::vector<Entry> entries;
+    SlabIndex<K, Hash> index;
+    std::vector<Stripe> stripes;
+    std::size_t capacity;
+    uint32_t generation = 0;
+
+    std::mutex drain_lock;  // the policy state below and all writes
+    std::vector<Node> nodes;
+    LFUPolicy::Order<Node> order;
+};
+
+template<class K, class V, class Hash>
+ConcurrentLFUCache<K, V, Hash>::ConcurrentLFUCache(std::size_t capacity, LFUAging aging, std::size_t stripes_count)
+    : index(capacity), stripes(std::max<std::size_t>(stripes_count, 1)), capacity(capacity), nodes(capacity),
+      order(LFUPolicy(aging), capacity) {
+    check_slab_capacity(capacity);
+    entries.reserve(capacity);
+}
+
+template<class K, class V, class Hash>
+std::size_t ConcurrentLFUCache<K, V, Hash>::size() const {
+    std::shared_lock<std::shared_mutex> lock(stripes[0].lock);
+    return entries.size();
+}
+
+template<class K, class V, class Hash>
+V ConcurrentLFUCache<K, V, Hash>::get(const K& key) {
+    auto value = find(key);
+    return value ? *value : cache_miss_value<V>();
+}
+
+template<class K, class V, class Hash>
+std::optional<V> ConcurrentLFUCache<K, V, Hash>::find(const K& key) {
+    auto& s = stripe();
+    std::optional<V> value;
+    uint32_t slot, slot_generation;
+    {
+        std::shared_lock<std::shared_mutex> lock(s.lock);
+        slot = lookup(key);
+        if (slot == slab_npos) {
+            return std::nullopt;
+        }
+        value = entries[slot].value;
+        slot_generation = entries[slot].generation;
+    }
+    record(s, slot, slot_generation);
+    return value;
+}
+
+template<class K, class V, class Hash>
+void ConcurrentLFUCache<K, V, Hash>::put(const K& key, const V& value) {
+    std::lock_guard<std::mutex> lock(drain_lock);
+    drain();
+    // the index only changes under the drain lock, so it can be read without a stripe lock here
+    auto slot = lookup(key);
+    if (slot != slab_npos) {
+        {
+            WriteLock write(stripes);
+            entries[slot].value = value;
+        }
+        order.touch(nodes, slot);
+        return;
+    }
+    insert(key, value);
+}
+
+template<class K, class V, class Hash>
+template<class F>
+std::pair<V, bool> ConcurrentLFUCache<K, V, Hash>::access(const K& key, F&& make_value) {
+    if (auto value = find(key)) {
+        return {std::move(*value), true};
+    }
+    std::lock_guard<std::mutex> lock(drain_lock);
+    drain();
+    // another thread may have cached it in the meantime
+    auto slot = lookup(key);
+    if (slot != slab_npos) {
+        order.touch(nodes, slot);
+        return {entries[slot].value, true};
+    }
+    V value = make_value();
+    insert(key, value);
+    return {std::move(value), false};
+}
+
+template<class K, class V, class Hash>
+void ConcurrentLFUCache<K, V, Hash>::record(Stripe& s, uint32_t slot, uint32_t slot_generation) {
+    auto event = static_cast<uint64_t>(slot) << 32 | slot_generation;
+    if (!s.buffer.offer(event) || s.buffer.pending() >= ReadBuffer::size / 2) {
+        std::unique_lock<std::mutex> lock(drain_lock, std::try_to_lock);
+        if (lock.owns_lock()) {
+            drain();
+        }
+    }
+}
+
+template<class K, class V, class Hash>
+void ConcurrentLFUCache<K, V, Hash>::drain() {
+    for (auto& s : stripes) {
+        s.buffer.drain([this](uint64_t event) {
+            auto slot = static_cast<uint32_t>(event >> 32);
+            if (entries[slot].generation == static_cast<uint32_t>(event)) {
+                order.touch(nodes, slot);
+            }
+        });
+    }
+}
+
+template<class K, class V, class Hash>
+void ConcurrentLFUCache<K, V, Hash>::insert(const K& key, const V& value) {
+    if (capacity == 0) {
+        return;
+    }
+    uint32_t slot;
+    {
+        WriteLock write(stripes);
+        ++generation;
+        if (entries.size() < capacity) {
+            slot = static_cast<uint32_t>(entries.size());
+            entries.push_back({key, value, generation});
+        } else {
+            slot = order.victim(nodes, slab_npos);
+            order.erase(nodes, slot, true);
+            index.erase(entries[slot].key, slot);
+            entries[slot] = {key, value, generation};
+        }
+        index.insert(key, slot);
+    }
+    order.insert(nodes, slot);
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include "slab.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// Key -> slot index for dense keys 0..U-1, a drop-in replacement for SlabIndex and FlatIndex when the
+// key universe is known in advance (offline trace replay, see remap_dense()). The index is a flat array
+// with an entry per key: a lookup is one load, without hashing or comparing keys.
+// The array grows to the largest key inserted, reserve() sizes it for the universe up front
+// (Cache::reserve_index(), the dense replays do it), so the accesses never resize it.
+template<class K = uint32_t>
+class DenseIndex {
+public:
+    DenseIndex(std::size_t = 0) {}
+
+    void reserve(std::size_t universe) {
+        if (universe > slots.size()) {
+            slots.resize(universe, slab_npos);
+        }
+    }
+
+    template<class KeyAt>
+    uint32_t find(const K& key, KeyAt&& key_at) const {
+        return find_in(bucket(key), key, key_at);
+    }
+
+    void insert(const K& key, uint32_t slot) {
+        insert_in(bucket(key), slot);
+    }
+
+    // the key itself
+    std::size_t bucket(const K& key) const { return static_cast<std::size_t>(key); }
+    uint64_t hash(const K& key) const { return static_cast<uint64_t>(key); }
+    std::size_t bucket_of(uint64_t hash) const { return static_cast<std::size_t>(hash); }
+
+    template<class KeyAt>
+    uint32_t find_in(std::size_t b, const K&, KeyAt&&) const {
+        return b < slots.size() ? slots[b] : slab_npos;
+    }
+
+    void insert_in(std::size_t b, uint32_t slot) {
+        if (b >= slots.size()) {
+            slots.resize(std::max(b + 1, 2 * slots.size()), slab_npos);
+        }
+        slots[b] = slot;
+    }
+
+    void erase(const K& key, uint32_t) {
+        slots[bucket(key)] = slab_npos;
+    }
+
+private:
+    std::vector<uint32_t> slots;  // slot of every key, slab_npos if it isn't cached
+};
+
+// A trace with its keys remapped to 0..universe-1 in the order of their first request.
+struct DenseTrace {
+    std::vector<uint32_t> keys;
+    std::size_t universe = 0;
+};
+
+// One hashing pre-pass over the trace, so replays of the remapped trace never hash again.
+// The trace of the given size comes from for_each_key(f), which calls f(key) for every request in order,
+// e.g. TraceReader::for_each() decoding a binary trace without another copy of it.
+template<class K, class Hash = std::hash<K>, class ForEachKey>
+DenseTrace remap_dense(std::size_t size, ForEachKey&& for_each_key) {
+    if (size >= slab_npos) {
+        throw std::length_error("Trace doesn't fit into 32-bit keys");
+    }
+    DenseTrace dense;
+    dense.keys.reserve(size);
+    std::unordered_map<K, uint32_t, Hash> ids;
+    for_each_key([&dense, &ids](const K& key) {
+        auto [it, inserted] = ids.try_emplace(key, static_cast<uint32_t>(ids.size()));
+        dense.keys.push_back(it->second);
+    });
+    dense.universe = ids.size();
+    return dense;
+}
+
+template<class K, class Hash = std::hash<K>>
+DenseTrace remap_dense(const std::vector<K>& trace) {
+    return remap_dense<K, Hash>(trace.size(), [&trace](auto&& f) {
+        for (const auto& key : trace) {
+            f(key);
+        }
+    });
+}
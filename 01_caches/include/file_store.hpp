@@ -0,0 +1,152 @@
+#pragma once
+#include "mapped_file.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Local stand-in for a key-value backend: an append-only file of fixed-size (key, value) records.
+// store() appends a whole batch with one pwrite() (and fdatasync() with sync), an in-memory index keeps
+// the offset of the last record of every key, so load() is one pread(). Opening an existing file
+// rebuilds the index with a scan, a torn record at the end (a crash mid-write) is cut off.
+// Keys and values are stored as raw bytes and have to be trivially copyable. Thread-safe: loads run
+// concurrently with a store, they see the records of a batch once all of it is written.
+template<class K, class V, class Hash = std::hash<K>>
+class FileStore {
+public:
+    static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                  "FileStore writes keys and values as raw bytes");
+
+    explicit FileStore(const std::string& path, bool sync = true);
+    FileStore(const FileStore&) = delete;
+    FileStore& operator=(const FileStore&) = delete;
+    ~FileStore() { ::close(fd); }
+
+    std::optional<V> load(const K& key) const;
+    // without reading the file
+    bool contains(const K& key) const;
+    void store(const std::vector<std::pair<K, V>>& batch);
+
+    // distinct keys
+    std::size_t size() const;
+    // store() calls
+    uint64_t batches() const;
+
+private:
+    struct Record {
+        K key;
+        V value;
+    };
+
+    std::string path;
+    bool sync;
+    int fd = -1;
+    std::mutex write_mutex;  // serialises the appends
+    mutable std::mutex index_mutex;
+    std::unordered_map<K, uint64_t, Hash> offsets;
+    uint64_t end = 0;
+    uint64_t batches_count = 0;
+};
+
+template<class K, class V, class Hash>
+FileStore<K, V, Hash>::FileStore(const std::string& path, bool sync) : path(path), sync(sync) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Can't open store file " + path);
+    }
+    // the destructor doesn't run if the constructor throws
+    try {
+        {
+            MappedFile file(path);
+            auto records = file.size() / sizeof(Record);
+            for (std::size_t i = 0; i < records; ++i) {
+                Record record;
+                std::memcpy(&record, file.data() + i * sizeof(Record), sizeof(Record));
+                offsets[record.key] = i * sizeof(Record);
+            }
+            end = records * sizeof(Record);
+        }
+        if (::ftruncate(fd, static_cast<off_t>(end)) != 0) {
+            throw std::runtime_error("Can't truncate store file " + path);
+        }
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+}
+
+template<class K, class V, class Hash>
+std::optional<V> FileStore<K, V, Hash>::load(const K& key) const {
+    uint64_t offset;
+    {
+        std::lock_guard<std::mutex> lock(index_mutex);
+        auto it = offsets.find(key);
+        if (it == offsets.end()) {
+            return std::nullopt;
+        }
+        offset = it->second;
+    }
+    // records are never overwritten, no lock needed to read one
+    Record record;
+    if (::pread(fd, &record, sizeof(record), static_cast<off_t>(offset)) != static_cast<ssize_t>(sizeof(record))) {
+        throw std::runtime_error("Can't read store file " + path);
+    }
+    return record.value;
+}
+
+template<class K, class V, class Hash>
+bool FileStore<K, V, Hash>::contains(const K& key) const {
+    std::lock_guard<std::mutex> lock(index_mutex);
+    return offsets.count(key) != 0;
+}
+
+template<class K, class V, class Hash>
+void FileStore<K, V, Hash>::store(const std::vector<std::pair<K, V>>& batch) {
+    std::lock_guard<std::mutex> write_lock(write_mutex);
+    std::vector<Record> records(batch.size());
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        records[i] = {batch[i].first, batch[i].second};
+    }
+    auto bytes = records.size() * sizeof(Record);
+    auto* data = reinterpret_cast<const char*>(records.data());
+    for (std::size_t written = 0; written < bytes;) {
+        auto n = ::pwrite(fd, data + written, bytes - written, static_cast<off_t>(end + written));
+        if (n < 0) {
+            throw std::runtime_error("Can't write store file " + path);
+        }
+        written += static_cast<std::size_t>(n);
+    }
+    if (sync && ::fdatasync(fd) != 0) {
+        throw std::runtime_error("Can't sync store file " + path);
+    }
+
+    std::lock_guard<std::mutex> lock(index_mutex);
+    for (std::size_t i = 0; i < records.size(); ++i) {
+        offsets[records[i].key] = end + i * sizeof(Record);
+    }
+    end += bytes;
+    ++batches_count;
+}
+
+template<class K, class V, class Hash>
+std::size_t FileStore<K, V, Hash>::size() const {
+    std::lock_guard<std::mutex> lock(index_mutex);
+    return offsets.size();
+}
+
+template<class K, class V, class Hash>
+uint64_t FileStore<K, V, Hash>::batches() const {
+    std::lock_guard<std::mutex> lock(index_mutex);
+    return batches_count;
+}
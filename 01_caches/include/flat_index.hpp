@@ -0,0 +1,196 @@
+#pragma once
+#include "slab.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Open addressing key -> slot index in the Swiss table style, a drop-in replacement for SlabIndex.
+// The table is an array of 64-byte groups: 16 control bytes (12 in use: empty, deleted or 7 bits of
+// the key hash) followed by the 12 slot numbers they describe, so a probe touches one cache line.
+// A lookup compares the 7 bits against the whole group at once (one SSE2 compare) and reads the slab
+// only for matching positions, a group with an empty position ends the probe sequence.
+// Groups are probed triangularly, which visits all of them for a power of 2.
+//
+// The index never holds more than `capacity` slots: the table has at least 1.5 * capacity positions
+// and is rebuilt in place when deleted positions eat up the slack, so steady-state churn of a cache
+// doesn't allocate. Hashes are remembered per slot for the rebuild.
+template<class K, class Hash = std::hash<K>>
+class FlatIndex {
+public:
+    FlatIndex(std::size_t capacity = 0) : hashes(capacity) {
+        std::size_t count = 1;
+        while (count * group_width < capacity + capacity / 2) {
+            count <<= 1;
+            ++group_bits;
+        }
+        group_mask = count - 1;
+        groups.resize(count);
+        max_load = count * group_width - count * group_width / 8;
+        scratch.reserve(capacity);
+    }
+
+    template<class KeyAt>
+    uint32_t find(const K& key, KeyAt&& key_at) const {
+        return find_in(bucket(key), key, key_at);
+    }
+
+    void insert(const K& key, uint32_t slot) {
+        insert_in(bucket(key), slot);
+    }
+
+    // the mixed hash of the key, find_in/insert_in take it so a find-or-insert hashes the key once
+    std::size_t bucket(const K& key) const {
+        return bucket_of(hash(key));
+    }
+
+    // a restored snapshot keeps the key hashes and gets the buckets without hashing the keys
+    uint64_t hash(const K& key) const { return static_cast<uint64_t>(hasher(key)); }
+    std::size_t bucket_of(uint64_t hash) const { return hash * 0x9E3779B97F4A7C15ull; }
+
+    template<class KeyAt>
+    uint32_t find_in(std::size_t h, const K& key, KeyAt&& key_at) const {
+        auto tag = tag_of(h);
+        auto g = first_group(h);
+        for (std::size_t step = 1;; ++step) {
+            auto& group = groups[g];
+            for (auto mask = match(group, tag); mask != 0; mask &= mask - 1) {
+                auto slot = group.slots[lowest_bit(mask)];
+                if (key_at(slot) == key) {
+                    return slot;
+                }
+            }
+            if (match(group, empty) != 0) {
+                return slab_npos;
+            }
+            g = (g + step) & group_mask;
+        }
+    }
+
+    void insert_in(std::size_t h, uint32_t slot) {
+        if (used + deleted >= max_load) {
+            rebuild();
+        }
+        hashes[slot] = h;
+        place(h, slot);
+    }
+
+    void erase(const K& key, uint32_t slot) {
+        auto h = bucket(key);
+        auto tag = tag_of(h);
+        auto g = first_group(h);
+        for (std::size_t step = 1;; ++step) {
+            auto& group = groups[g];
+            for (auto mask = match(group, tag); mask != 0; mask &= mask - 1) {
+                auto i = lowest_bit(mask);
+                if (group.slots[i] == slot) {
+                    // no probe sequence went past a group that still has an empty position
+                    if (match(group, empty) != 0) {
+                        group.control[i] = empty;
+                    } else {
+                        group.control[i] = tombstone;
+                        ++deleted;
+                    }
+                    --used;
+                    return;
+                }
+            }
+            g = (g + step) & group_mask;
+        }
+    }
+
+private:
+    static constexpr int group_width = 12;
+    static constexpr uint32_t width_mask = (1u << group_width) - 1;
+    static constexpr int8_t empty = -128;    // 0x80
+    static constexpr int8_t tombstone = -2;  // 0xFE, a full position has the high bit clear
+    static constexpr int8_t padding = -1;    // 0xFF, the 4 control bytes without a position
+
+    struct alignas(64) Group {
+        int8_t control[16] = {empty, empty, empty, empty, empty, empty, empty, empty,
+                              empty, empty, empty, empty, padding, padding, padding, padding};
+        uint32_t slots[group_width];
+    };
+
+    static int8_t tag_of(uint64_t h) { return static_cast<int8_t>(h >> 57); }
+    std::size_t first_group(uint64_t h) const { return group_bits == 0 ? 0 : (h >> (57 - group_bits)) & group_mask; }
+
+    static int lowest_bit(uint32_t mask) { return __builtin_ctz(mask); }
+
+    // bit i is set iff control byte i of the group equals c (never true for the padding)
+    static uint32_t match(const Group& group, int8_t c) {
+#ifdef __SSE2__
+        auto bytes = _mm_load_si128(reinterpret_cast<const __m128i*>(group.control));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(c))));
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < group_width; ++i) {
+            mask |= uint32_t{group.control[i] == c} << i;
+        }
+        return mask;
+#endif
+    }
+
+    // bit i is set iff position i of the group is empty or deleted
+    static uint32_t match_free(const Group& group) {
+#ifdef __SSE2__
+        auto bytes = _mm_load_si128(reinterpret_cast<const __m128i*>(group.control));
+        return static_cast<uint32_t>(_mm_movemask_epi8(bytes)) & width_mask;
+#else
+        uint32_t mask = 0;
+        for (int i = 0; i < group_width; ++i) {
+            mask |= uint32_t{group.control[i] < 0} << i;
+        }
+        return mask;
+#endif
+    }
+
+    void place(uint64_t h, uint32_t slot) {
+        auto g = first_group(h);
+        for (std::size_t step = 1;; ++step) {
+            auto& group = groups[g];
+            if (auto mask = match_free(group); mask != 0) {
+                auto i = lowest_bit(mask);
+                if (group.control[i] == tombstone) {
+                    --deleted;
+                }
+                group.control[i] = tag_of(h);
+                group.slots[i] = slot;
+                ++used;
+                return;
+            }
+            g = (g + step) & group_mask;
+        }
+    }
+
+    // drops the deleted positions by inserting every slot again
+    void rebuild() {
+        scratch.clear();
+        for (auto& group : groups) {
+            for (int i = 0; i < group_width; ++i) {
+                if (group.control[i] >= 0) {
+                    scratch.push_back(group.slots[i]);
+                }
+                group.control[i] = empty;
+            }
+        }
+        used = deleted = 0;
+        for (auto slot : scratch) {
+            place(hashes[slot], slot);
+        }
+    }
+
+    std::vector<Group> groups;
+    std::vector<uint64_t> hashes;  // mixed hash of the key in each slot
+    std::vector<uint32_t> scratch;
+    std::size_t group_mask = 0;
+    int group_bits = 0;
+    std::size_t used = 0;
+    std::size_t deleted = 0;
+    std::size_t max_load = 0;
+    Hash hasher;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Count-min sketch of 4-bit counters estimating how often a key was seen recently.
+// 4 rows of 4 * capacity counters packed 16 per word take 8 bytes per cached entry.
+// After 10 * capacity increments all counters are halved, so old popularity fades away.
+template<class K, class Hash = std::hash<K>>
+class FrequencySketch {
+public:
+    FrequencySketch(std::size_t capacity = 0) : sample_size(10 * std::max<std::size_t>(capacity, 1)) {
+        while (width < 4 * capacity) {
+            width <<= 1;
+        }
+        table.assign(depth * width / counters_per_word, 0);
+    }
+
+    void increment(const K& key);
+    int estimate(const K& key) const;
+
+private:
+    static constexpr int depth = 4;
+    static constexpr std::size_t counters_per_word = 16;
+    static constexpr uint64_t max_count = 15;
+    static constexpr uint64_t seeds[depth] = {
+        0xc3a5c85c97cb3127ull, 0xb492b66fbe98f273ull, 0x9ae16a3b2f90404full, 0xcbf29ce484222325ull
+    };
+
+    // position of the key's counter in a row: the seeded hash goes through the full splitmix64
+    // finalizer per row, so the rows' positions don't move together like with one multiply
+    std::size_t counter(uint64_t h, int row) const {
+        uint64_t x = h + seeds[row];
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        x ^= x >> 31;
+        return x & (width - 1);
+    }
+
+    uint64_t& word(int row, std::size_t i) {
+        return table[(row * width + i) / counters_per_word];
+    }
+
+    uint64_t word(int row, std::size_t i) const {
+        return table[(row * width + i) / counters_per_word];
+    }
+
+    static int shift(std::size_t i) {
+        return static_cast<int>(i % counters_per_word) * 4;
+    }
+
+    void reset();
+
+    std::vector<uint64_t> table;
+    std::size_t width = 16;
+    std::size_t additions = 0;
+    std::size_t sample_size;
+    Hash hasher;
+};
+
+template<class K, class Hash>
+void FrequencySketch<K, Hash>::increment(const K& key) {
+    auto h = static_cast<uint64_t>(hasher(key));
+    bool added = false;
+    for (int row = 0; row < depth; ++row) {
+        auto i = counter(h, row);
+        auto& w = word(row, i);
+        if (((w >> shift(i)) & max_count) < max_count) {
+            w += uint64_t{1} << shift(i);
+            added = true;
+        }
+    }
+    if (added && ++additions == sample_size) {
+        reset();
+    }
+}
+
+template<class K, class Hash>
+int FrequencySketch<K, Hash>::estimate(const K& key) const {
+    auto h = static_cast<uint64_t>(hasher(key));
+    auto freq = max_count;
+    for (int row = 0; row < depth; ++row) {
+        auto i = counter(h, row);
+        freq = std::min(freq, (word(row, i) >> shift(i)) & max_count);
+    }
+    return static_cast<int>(freq);
+}
+
+template<class K, class Hash>
+void FrequencySketch<K, Hash>::reset() {
+    for (auto& w : table) {
+        w = (w >> 1) & 0x7777777777777777ull;
+    }
+    additions /= 2;
+}
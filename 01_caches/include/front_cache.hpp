@@ -0,0 +1,223 @@
+#pragma once
+#include "cache_stats.hpp"
+#include "lru.hpp"
+#include "sharding.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+inline uint64_t next_front_cache_id() {
+    static std::atomic<uint64_t> id{0};
+    return ++id;
+}
+
+// Two-level cache: every thread reads through its own small direct-mapped L1 in front of a shared L2
+// of independently locked Backing shards (LRUCache, LFUCache, ...), so the hottest keys are served
+// from memory no other core writes.
+//
+// Writes stay coherent through versions: keys hash to a table of version stripes, every L2 insert
+// (put() or a miss of access()) bumps the stripe of the key under the L2 shard lock, and an L1 entry
+// remembers the stripe version it was filled with. An L1 hit is a load of that version; while nobody
+// writes to the stripe all threads keep its cache line shared, a write invalidates the L1 copies of
+// the keys of its stripe only.
+// A get() after put() returned sees the new value in every thread.
+//
+// L1 hits don't reach the L2, so its policy sees the first request of a key after every L1 miss,
+// which is what decides eviction anyway for all but the hottest keys.
+// Each thread keeps the L1s of the last few caches it used, until it exits.
+template<class K = int, class V = int, class Backing = LRUCache<K, V>, class Hash = std::hash<K>>
+class FrontCache {
+public:
+    FrontCache(std::size_t shards_count, std::size_t shard_capacity, std::size_t front_size = 256,
+        std::size_t stripes = 4096);
+
+    std::size_t shards_count() const { return shards.size(); }
+    // entries of the L2
+    std::size_t size() const;
+
+    // returns -1 (V{} for non-arithmetic values) on a miss like LRUCache::get
+    V get(const K& key);
+    std::optional<V> find(const K& key);
+    void put(const K& key, const V& value);
+
+    // the cached value, or make_value() cached on a miss; .second tells whether it was a hit
+    template<class F>
+    std::pair<V, bool> access(const K& key, F&& make_value);
+
+    // L1 hits and misses of the calling thread, a copy: the thread's L1s move when it uses another cache
+    CacheStats front_stats() { return front().stats; }
+
+private:
+    static constexpr std::size_t max_fronts = 8;
+
+    struct FrontEntry {
+        K key;
+        V value;
+        uint64_t version = 0;  // 0: empty, stripe versions start at 1
+    };
+
+    struct Front {
+        uint64_t owner;
+        std::vector<FrontEntry> entries;
+        CacheStats stats;
+    };
+
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        Backing cache;
+    };
+
+    struct Position {
+        std::size_t slot;    // in the L1
+        std::size_t stripe;  // of the version table
+        std::size_t shard;
+    };
+
+    Position position(const K& key) const {
+        auto h = static_cast<uint64_t>(hasher(key));
+        // fibonacci hashing for the L1 (its top bits), independent bits for the stripes and shards
+        auto a = h * 0x9E3779B97F4A7C15ull;
+        auto b = shard_hash(h);
+        return {static_cast<std::size_t>(front_bits == 0 ? 0 : a >> (64 - front_bits)),
+                static_cast<std::size_t>(b) & stripe_mask, shard_index(b, shards.size())};
+    }
+
+    Front& front();
+    // the L1 entry of the key if it's still current
+    FrontEntry* front_hit(Front& f, const K& key, const Position& p);
+    // with the shard lock held: the current stripe version goes with the value
+    void fill(Front& f, const K& key, const V& value, const Position& p);
+
+    uint64_t id = next_front_cache_id();
+    int front_bits = 0;
+    std::size_t stripe_mask;
+    std::unique_ptr<std::atomic<uint64_t>[]> versions;
+    std::vector<Shard> shards;
+    Hash hasher;
+};
+
+template<class K, class V, class Backing, class Hash>
+FrontCache<K, V, Backing, Hash>::FrontCache(std::size_t shards_count, std::size_t shard_capacity,
+    std::size_t front_size, std::size_t stripes)
+    : shards(make_shards<Shard>(shards_count)) {
+    while ((std::size_t{1} << front_bits) < front_size) {
+        ++front_bits;
+    }
+    std::size_t stripes_count = 1;
+    while (stripes_count < stripes) {
+        stripes_count <<= 1;
+    }
+    stripe_mask = stripes_count - 1;
+    versions.reset(new std::atomic<uint64_t>[stripe_mask + 1]);
+    for (std::size_t i = 0; i <= stripe_mask; ++i) {
+        versions[i].store(1, std::memory_order_relaxed);
+    }
+    for (auto& s : shards) {
+        s.cache = Backing(shard_capacity);
+    }
+}
+
+template<class K, class V, class Backing, class Hash>
+std::size_t FrontCache<K, V, Backing, Hash>::size() const {
+    std::size_t total = 0;
+    for (auto& s : shards) {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        total += s.cache.size();
+    }
+    return total;
+}
+
+template<class K, class V, class Backing, class Hash>
+V FrontCache<K, V, Backing, Hash>::get(const K& key) {
+    auto value = find(key);
+    return value ? *value : cache_miss_value<V>();
+}
+
+template<class K, class V, class Backing, class Hash>
+std::optional<V> FrontCache<K, V, Backing, Hash>::find(const K& key) {
+    auto& f = front();
+    auto p = position(key);
+    if (auto* e = front_hit(f, key, p)) {
+        return e->value;
+    }
+    auto& s = shards[p.shard];
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (auto* value = s.cache.find(key)) {
+        fill(f, key, *value, p);
+        return *value;
+    }
+    return std::nullopt;
+}
+
+template<class K, class V, class Backing, class Hash>
+void FrontCache<K, V, Backing, Hash>::put(const K& key, const V& value) {
+    auto& f = front();
+    auto p = position(key);
+    auto& s = shards[p.shard];
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.cache.put(key, value);
+    // release: a reader that sees the new version reads the new value from the L2
+    versions[p.stripe].fetch_add(1, std::memory_order_release);
+    fill(f, key, value, p);
+}
+
+template<class K, class V, class Backing, class Hash>
+template<class F>
+std::pair<V, bool> FrontCache<K, V, Backing, Hash>::access(const K& key, F&& make_value) {
+    auto& f = front();
+    auto p = position(key);
+    if (auto* e = front_hit(f, key, p)) {
+        return {e->value, true};
+    }
+    auto& s = shards[p.shard];
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto [value, hit] = s.cache.access(key, make_value);
+    if (value == nullptr) {
+        // a zero-capacity L2 doesn't keep it, and neither does the L1
+        return {make_value(), false};
+    }
+    if (!hit) {
+        // the key may have been evicted from the L2 with an older value still in other threads' L1s
+        versions[p.stripe].fetch_add(1, std::memory_order_release);
+    }
+    fill(f, key, *value, p);
+    return {*value, hit};
+}
+
+template<class K, class V, class Backing, class Hash>
+typename FrontCache<K, V, Backing, Hash>::Front& FrontCache<K, V, Backing, Hash>::front() {
+    thread_local std::vector<Front> fronts;
+    for (auto& f : fronts) {
+        if (f.owner == id) {
+            return f;
+        }
+    }
+    if (fronts.size() == max_fronts) {
+        fronts.erase(fronts.begin());
+    }
+    fronts.push_back({id, std::vector<FrontEntry>(std::size_t{1} << front_bits), {}});
+    return fronts.back();
+}
+
+template<class K, class V, class Backing, class Hash>
+typename FrontCache<K, V, Backing, Hash>::FrontEntry* FrontCache<K, V, Backing, Hash>::front_hit(Front& f,
+    const K& key, const Position& p) {
+    auto& e = f.entries[p.slot];
+    bool hit = e.version != 0 && e.version == versions[p.stripe].load(std::memory_order_acquire) && e.key == key;
+    f.stats.record(hit, 1);
+    return hit ? &e : nullptr;
+}
+
+template<class K, class V, class Backing, class Hash>
+void FrontCache<K, V, Backing, Hash>::fill(Front& f, const K& key, const V& value, const Position& p) {
+    auto& e = f.entries[p.slot];
+    e.key = key;
+    e.value = value;
+    e.version = versions[p.stripe].load(std::memory_order_relaxed);
+}
@@ -1,19 +1,202 @@
-#include <list>
-#include <unordered_map>
-
-class LFUCache {
-public:
-    LFUCache() = default;
-    LFUCache(int capacity) : capacity(capacity) {}
-
-    bool full() const;
-    int get(int key);
-    void put(int key, int value);
-
-private:
-    using ListIt = typename std::list<std::pair<int, int>>::iterator;
-    std::unordered_map<int, std::pair<int, ListIt>> cache;
-    std::unordered_map<int, std::list<std::pair<int, int>> > freq;
-    int capacity;
-    int min_freq;
+#pragma once
+#include "cache.hpp"
+#include "slab.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Constant time LFU: a list of frequency buckets sorted by frequency, each bucket keeps
+// its entries from the most to the least recently promoted one.
+// A hit moves the entry into the next bucket (creating it right after the current one if needed),
+// eviction takes the least recent entry of the first bucket.
+// Buckets live in a slab allocated once for `capacity` entries, so neither a hit nor an eviction allocates.
+//
+// With LFUAging::dynamic the cache works as LFU-DA: buckets are ordered by priority = frequency + age,
+// where age is the priority of the last evicted entry. Entries keep their frequency, a hit recomputes
+// the priority against the current age, so keys that were hot long ago lose to the recent ones after
+// enough evictions. That hit moves the entry past the buckets between its old and new priority: the
+// entries last hit at an older age, not constant time but few of them unless the age jumped far.
+// Expiry and entries dropped by put() don't change the age, only evictions do.
+//
+// Snapshots keep the frequencies, the priorities and the age.
+enum class LFUAging {
+    none,
+    dynamic
+};
+
+struct LFUPolicy {
+    static constexpr const char* name = "lfu";
+    static constexpr SnapshotKind snapshot_kind = SnapshotKind::lfu;
+
+    struct Hook {
+        uint32_t bucket;
+        uint64_t freq;
+    };
+
+    LFUPolicy(LFUAging aging = LFUAging::none) : aging(aging) {}
+
+    LFUAging aging;
+
+    template<class Entry>
+    class Order : public OrderDefaults {
+    public:
+        Order() = default;
+        Order(LFUPolicy policy, std::size_t capacity) : aging(policy.aging) {
+            // a hit may create the next bucket before the current one gets empty
+            buckets.reserve(capacity + 1);
+        }
+
+        void touch(std::vector<Entry>& entries, uint32_t slot);
+        void insert(std::vector<Entry>& entries, uint32_t slot);
+        uint32_t victim(const std::vector<Entry>& entries, uint32_t keep) const;
+        void erase(std::vector<Entry>& entries, uint32_t slot, bool evicted);
+
+        // from the most frequent bucket, every bucket from its most recent entry
+        template<class F>
+        void visit(const std::vector<Entry>& entries, F&& f) const;
+        void append(std::vector<Entry>& entries, uint32_t slot, uint64_t freq, uint64_t priority);
+        uint64_t age() const { return current_age; }
+        void set_age(uint64_t new_age) { current_age = new_age; }
+
+    private:
+        struct Bucket {
+            uint64_t priority;  // the frequency without aging
+            SlabLinks links;
+            SlabList<Entry> entries;
+        };
+
+        uint32_t acquire_bucket(uint64_t priority);
+        void release_bucket(uint32_t b);
+
+        std::vector<Bucket> buckets;
+        SlabList<Bucket> freq_list;
+        uint32_t free_buckets = slab_npos;  // released buckets chained through links.next
+        LFUAging aging = LFUAging::none;
+        uint64_t current_age = 0;
+    };
 };
+
+// Index maps keys to entry slots: SlabIndex (chained) or FlatIndex (open addressing).
+template<class K = int, class V = int, class Hash = std::hash<K>, class Index = SlabIndex<K, Hash>>
+using LFUCache = Cache<K, V, LFUPolicy, Index>;
+
+template<class Entry>
+void LFUPolicy::Order<Entry>::insert(std::vector<Entry>& entries, uint32_t slot) {
+    // every priority is at least the age, except for entries kept while a weighted put() of theirs
+    // evicted the ones above them (see victim()): the walk passes a bucket or two
+    auto priority = current_age + 1;
+    auto prev = slab_npos;
+    auto b = freq_list.front();
+    while (b != slab_npos && buckets[b].priority < priority) {
+        prev = b;
+        b = buckets[b].links.next;
+    }
+    if (b == slab_npos || buckets[b].priority != priority) {
+        b = acquire_bucket(priority);
+        if (prev == slab_npos) {
+            freq_list.push_front(buckets, b);
+        } else {
+            freq_list.insert_after(buckets, prev, b);
+        }
+    }
+    buckets[b].entries.push_front(entries, slot);
+    entries[slot].bucket = b;
+    entries[slot].freq = 1;
+}
+
+template<class Entry>
+void LFUPolicy::Order<Entry>::touch(std::vector<Entry>& entries, uint32_t slot) {
+    auto b = entries[slot].bucket;
+    auto freq = ++entries[slot].freq;
+    // the age never decreases, so the new priority is above the current bucket: without aging
+    // it's the next one, with aging the walk passes the entries last hit at an older age
+    auto priority = aging == LFUAging::dynamic ? current_age + freq : freq;
+    auto prev = b;
+    auto next = buckets[b].links.next;
+    while (next != slab_npos && buckets[next].priority < priority) {
+        prev = next;
+        next = buckets[next].links.next;
+    }
+    if (next == slab_npos || buckets[next].priority != priority) {
+        next = acquire_bucket(priority);
+        freq_list.insert_after(buckets, prev, next);
+    }
+    buckets[b].entries.unlink(entries, slot);
+    buckets[next].entries.push_front(entries, slot);
+    entries[slot].bucket = next;
+    if (buckets[b].entries.empty()) {
+        release_bucket(b);
+    }
+}
+
+// the least recent entry among the least frequently used ones, other than `keep`
+template<class Entry>
+uint32_t LFUPolicy::Order<Entry>::victim(const std::vector<Entry>& entries, uint32_t keep) const {
+    auto b = freq_list.front();
+    auto slot = buckets[b].entries.back();
+    if (slot == keep) {
+        slot = entries[slot].links.prev;
+        if (slot == slab_npos) {
+            slot = buckets[buckets[b].links.next].entries.back();
+        }
+    }
+    return slot;
+}
+
+template<class Entry>
+void LFUPolicy::Order<Entry>::erase(std::vector<Entry>& entries, uint32_t slot, bool evicted) {
+    auto b = entries[slot].bucket;
+    if (evicted && aging == LFUAging::dynamic) {
+        current_age = buckets[b].priority;
+    }
+    buckets[b].entries.unlink(entries, slot);
+    if (buckets[b].entries.empty()) {
+        release_bucket(b);
+    }
+}
+
+template<class Entry>
+template<class F>
+void LFUPolicy::Order<Entry>::visit(const std::vector<Entry>& entries, F&& f) const {
+    for (auto b = freq_list.back(); b != slab_npos; b = buckets[b].links.prev) {
+        for (auto slot = buckets[b].entries.front(); slot != slab_npos; slot = entries[slot].links.next) {
+            f(slot, entries[slot].freq, buckets[b].priority);
+        }
+    }
+}
+
+template<class Entry>
+void LFUPolicy::Order<Entry>::append(std::vector<Entry>& entries, uint32_t slot, uint64_t freq,
+    uint64_t priority) {
+    auto b = freq_list.front();
+    if (b == slab_npos || buckets[b].priority != priority) {
+        b = acquire_bucket(priority);
+        freq_list.push_front(buckets, b);
+    }
+    buckets[b].entries.push_back(entries, slot);
+    entries[slot].bucket = b;
+    entries[slot].freq = freq;
+}
+
+template<class Entry>
+uint32_t LFUPolicy::Order<Entry>::acquire_bucket(uint64_t priority) {
+    uint32_t b;
+    if (free_buckets != slab_npos) {
+        b = free_buckets;
+        free_buckets = buckets[b].links.next;
+        buckets[b].links = {};
+    } else {
+        b = static_cast<uint32_t>(buckets.size());
+        buckets.push_back({});
+    }
+    buckets[b].priority = priority;
+    return b;
+}
+
+template<class Entry>
+void LFUPolicy::Order<Entry>::release_bucket(uint32_t b) {
+    freq_list.unlink(buckets, b);
+    buckets[b].links.next = free_buckets;
+    free_buckets = b;
+}
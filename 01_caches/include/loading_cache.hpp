@@ -0,0 +1,173 @@
+#pragma once
+#include "lru.hpp"
+#include "sharding.hpp"
+
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// Thread-safe read-through LRU: a miss calls the loader and caches what it returns.
+// Every shard remembers the keys being loaded, concurrent misses of such a key wait for the one
+// load in flight instead of calling the loader again. The loader runs without any lock held.
+// A failed load is reported to all its waiters and isn't cached, the next miss tries again.
+template<class K = int, class V = int, class Hash = std::hash<K>>
+class LoadingCache {
+public:
+    LoadingCache(std::size_t shards_count, std::size_t shard_capacity) : shards(make_shards<Shard>(shards_count)) {
+        for (auto& s : shards) {
+            s.cache = LRUCache<K, V, Hash>(shard_capacity);
+        }
+    }
+
+    std::size_t size() const;
+
+    // loader(key) returns the value
+    template<class Loader>
+    V get_or_load(const K& key, Loader&& loader);
+
+    // values of all keys in order, loader(missing keys) is called at most once and returns their
+    // values in the same order; keys already being loaded by other calls are waited for
+    template<class BatchLoader>
+    std::vector<V> get_many(const std::vector<K>& keys, BatchLoader&& loader);
+
+private:
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        LRUCache<K, V, Hash> cache;
+        std::unordered_map<K, std::shared_future<V>, Hash> loading;
+    };
+
+    Shard& shard(const K& key) { return pick_shard(shards, hasher, key); }
+
+    struct Lookup {
+        std::optional<V> value;          // cached value
+        std::shared_future<V> pending;   // the load to wait for otherwise
+        bool owner = false;              // the load was registered by this lookup
+    };
+
+    // looks the key up, registers a load of it in the promise if it's neither cached nor being loaded
+    Lookup find_or_wait(const K& key, std::promise<V>& promise);
+    void loaded(const K& key, const V& value);
+    void failed(const K& key);
+
+    std::vector<Shard> shards;
+    Hash hasher;
+};
+
+template<class K, class V, class Hash>
+std::size_t LoadingCache<K, V, Hash>::size() const {
+    std::size_t total = 0;
+    for (auto& s : shards) {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        total += s.cache.size();
+    }
+    return total;
+}
+
+template<class K, class V, class Hash>
+template<class Loader>
+V LoadingCache<K, V, Hash>::get_or_load(const K& key, Loader&& loader) {
+    std::promise<V> promise;
+    auto lookup = find_or_wait(key, promise);
+    if (lookup.value) {
+        return *lookup.value;
+    }
+    if (!lookup.owner) {
+        return lookup.pending.get();
+    }
+
+    try {
+        V value = loader(key);
+        loaded(key, value);
+        promise.set_value(value);
+        return value;
+    } catch (...) {
+        failed(key);
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+template<class K, class V, class Hash>
+template<class BatchLoader>
+std::vector<V> LoadingCache<K, V, Hash>::get_many(const std::vector<K>& keys, BatchLoader&& loader) {
+    // a repeated missing key finds the load registered for its first occurrence and waits for it
+    std::vector<Lookup> lookups;
+    lookups.reserve(keys.size());
+    std::vector<K> missing;
+    std::vector<std::promise<V>> promises;
+    for (auto& key : keys) {
+        std::promise<V> promise;
+        lookups.push_back(find_or_wait(key, promise));
+        if (lookups.back().owner) {
+            missing.push_back(key);
+            promises.push_back(std::move(promise));
+        }
+    }
+
+    std::size_t done = 0;
+    if (!missing.empty()) {
+        try {
+            auto values = loader(missing);
+            if (values.size() != missing.size()) {
+                throw std::length_error("Batch loader should return a value for every key");
+            }
+            for (; done < missing.size(); ++done) {
+                loaded(missing[done], values[done]);
+                promises[done].set_value(values[done]);
+            }
+        } catch (...) {
+            for (; done < missing.size(); ++done) {
+                failed(missing[done]);
+                promises[done].set_exception(std::current_exception());
+            }
+            throw;
+        }
+    }
+
+    std::vector<V> values;
+    values.reserve(keys.size());
+    for (auto& lookup : lookups) {
+        values.push_back(lookup.value ? *lookup.value : lookup.pending.get());
+    }
+    return values;
+}
+
+template<class K, class V, class Hash>
+typename LoadingCache<K, V, Hash>::Lookup LoadingCache<K, V, Hash>::find_or_wait(const K& key,
+    std::promise<V>& promise) {
+    auto& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    Lookup lookup;
+    if (auto* value = s.cache.find(key)) {
+        lookup.value = *value;
+        return lookup;
+    }
+    auto [it, inserted] = s.loading.try_emplace(key);
+    if (inserted) {
+        it->second = promise.get_future().share();
+        lookup.owner = true;
+    }
+    lookup.pending = it->second;
+    return lookup;
+}
+
+template<class K, class V, class Hash>
+void LoadingCache<K, V, Hash>::loaded(const K& key, const V& value) {
+    auto& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.cache.put(key, value);
+    s.loading.erase(key);
+}
+
+template<class K, class V, class Hash>
+void LoadingCache<K, V, Hash>::failed(const K& key) {
+    auto& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.loading.erase(key);
+}
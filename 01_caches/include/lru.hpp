@@ -1,20 +1,50 @@
-#include <list>
-#include <unordered_map>
+#pragma once
+#include "cache.hpp"
+#include "slab.hpp"
 
-class LRUCache {
-public:
-    LRUCache() = default;
-    LRUCache(int capacity) : capacity(capacity) {};
+#include <cstdint>
+#include <functional>
+#include <vector>
 
-    bool full() const;
-    int get(int key);
-    void put(int key, int value);
+// LRU eviction: a recency list threaded through the entries, a hit moves the entry to the front,
+// the victim is the back one. Snapshots keep the recency order.
+struct LRUPolicy {
+    static constexpr const char* name = "lru";
+    static constexpr SnapshotKind snapshot_kind = SnapshotKind::lru;
 
-private:
-    using ListIt = typename std::list<std::pair<int, int>>::iterator;
-    void move_front(const ListIt& elit);
+    struct Hook {};
 
-    std::list<std::pair<int, int>> cache;
-    std::unordered_map<int, ListIt> hash;
-    int capacity;
+    template<class Entry>
+    class Order : public OrderDefaults {
+    public:
+        Order() = default;
+        Order(LRUPolicy, std::size_t) {}
+
+        void touch(std::vector<Entry>& entries, uint32_t slot) { recency.move_front(entries, slot); }
+        void insert(std::vector<Entry>& entries, uint32_t slot) { recency.push_front(entries, slot); }
+
+        uint32_t victim(const std::vector<Entry>& entries, uint32_t keep) const {
+            auto slot = recency.back();
+            return slot != keep ? slot : entries[slot].links.prev;
+        }
+
+        void erase(std::vector<Entry>& entries, uint32_t slot, bool) { recency.unlink(entries, slot); }
+
+        // from the most to the least recent entry
+        template<class F>
+        void visit(const std::vector<Entry>& entries, F&& f) const {
+            for (auto slot = recency.front(); slot != slab_npos; slot = entries[slot].links.next) {
+                f(slot, 0, 0);
+            }
+        }
+
+        void append(std::vector<Entry>& entries, uint32_t slot, uint64_t, uint64_t) { recency.push_back(entries, slot); }
+
+    private:
+        SlabList<Entry> recency;
+    };
 };
+
+// LRU cache over a slab of `capacity` entries (see Cache).
+template<class K = int, class V = int, class Hash = std::hash<K>, class Index = SlabIndex<K, Hash>>
+using LRUCache = Cache<K, V, LRUPolicy, Index>;
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Whole file mapped read-only for one sequential pass: the kernel reads ahead and the bytes are read
+// straight from the page cache, without copies into user buffers.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Can't open file " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            close();
+            throw std::runtime_error("Can't stat file " + path);
+        }
+        length = static_cast<std::size_t>(st.st_size);
+        if (length == 0) {
+            return;
+        }
+        auto* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            close();
+            throw std::runtime_error("Can't map file " + path);
+        }
+        bytes = static_cast<const char*>(mapped);
+        ::madvise(mapped, length, MADV_SEQUENTIAL);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    const char* data() const { return bytes; }
+    std::size_t size() const { return length; }
+
+private:
+    void close() {
+        if (bytes != nullptr) {
+            ::munmap(const_cast<char*>(bytes), length);
+            bytes = nullptr;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    int fd = -1;
+    const char* bytes = nullptr;
+    std::size_t length = 0;
+};
@@ -0,0 +1,46 @@
+#pragma once
+#include "avl_tree/avl_tree.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// Miss-ratio curve of LRU in one pass (Mattson stack distances).
+// An access hits an LRU cache of capacity c iff at most c distinct keys (including itself) were
+// accessed since the previous access of the same key. The last access times of all keys live in
+// an AVL tree with subtree counts, so this number is one less_count() away:
+// O(n log u) for the whole curve instead of a replay per capacity.
+//
+// Returns hits for every capacity, hits[c] for c in [0, max_capacity].
+template<class K, class Hash = std::hash<K>>
+std::vector<uint64_t> lru_hits_curve(const std::vector<K>& keys, std::size_t max_capacity) {
+    if (keys.size() > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+        throw std::length_error("Trace doesn't fit into int timestamps");
+    }
+    std::vector<uint64_t> hits(max_capacity + 1, 0);
+    std::unordered_map<K, int, Hash> last_access;
+    AVLTree<int> times;
+    int distinct = 0;
+    for (int t = 0; t < static_cast<int>(keys.size()); ++t) {
+        auto [it, inserted] = last_access.try_emplace(keys[t], t);
+        if (inserted) {
+            ++distinct;
+        } else {
+            auto prev = it->second;
+            auto distance = static_cast<std::size_t>(distinct - times.less_count(prev));
+            if (distance <= max_capacity) {
+                ++hits[distance];
+            }
+            times.erase(prev);
+            it->second = t;
+        }
+        times.insert(t);
+    }
+    for (std::size_t c = 1; c <= max_capacity; ++c) {
+        hits[c] += hits[c - 1];
+    }
+    return hits;
+}
@@ -1,28 +1,184 @@
+#pragma once
+#include "cache.hpp"
+#include "slab.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
 #include <unordered_map>
+#include <utility>
 #include <vector>
-#include <list>
-#include <set>
 
 // perfect cache structure that "knows" the future
 // therefore can implement perfect caching strategy -
 // see the element that will be met later others and pop it
-class PerfectCache {
+//
+// The cache replays the trace it was built from: every get/find consumes the next trace element,
+// put of a missing key caches it as the element its get/find has just missed
+// (or consumes the next element if there was no such lookup).
+// One reverse pass over the trace fills a flat next_use array (position of the next access of the
+// same key), resident entries are kept in a binary max-heap by their next use, both are contiguous
+// arrays: 4 bytes per trace element plus O(capacity + distinct keys) for the whole simulation.
+template<class K, class Hash = std::hash<K>>
+class PerfectPolicy {
 public:
-    PerfectCache() = default;
-    PerfectCache(int capacity, const std::vector<int>& keys);
+    static constexpr const char* name = "perfect";
 
-    bool full() const;
-    int get(int key);
-    void put(int key, int value);
+    struct Hook {
+        uint32_t next_use;
+        uint32_t heap_pos;
+    };
 
-private:
-    using ListIt = typename std::list<std::pair<int, int>>::iterator;
-    void move_front(const ListIt& elit);
+    PerfectPolicy() = default;
+    // the trace the cache replays
+    PerfectPolicy(const std::vector<K>& keys);
+    // a trace of dense keys 0..universe-1 (see remap_dense()): next uses come from a flat array, not a hash map
+    PerfectPolicy(const std::vector<K>& keys, std::size_t universe);
+
+    template<class Entry>
+    class Order : public OrderDefaults {
+    public:
+        Order() = default;
+        Order(PerfectPolicy policy, std::size_t capacity) : next_use(std::move(policy.next_use)) {
+            heap.reserve(capacity);
+        }
+
+        void before_lookup() { current = consume(); }
+        void before_put() {
+            current = missed_position != slab_npos ? missed_position : consume();
+            missed_position = slab_npos;
+        }
+        void missed() { missed_position = current; }
+
+        void touch(std::vector<Entry>& entries, uint32_t slot) {
+            // the next use only moves further, so the entry can only go up the max-heap
+            entries[slot].next_use = next_use[current];
+            sift_up(entries, entries[slot].heap_pos);
+        }
+
+        void insert(std::vector<Entry>& entries, uint32_t slot) {
+            entries[slot].next_use = next_use[current];
+            entries[slot].heap_pos = static_cast<uint32_t>(heap.size());
+            heap.push_back(slot);
+            sift_up(entries, entries[slot].heap_pos);
+        }
+
+        // the entry needed furthest in the future
+        uint32_t victim(const std::vector<Entry>& entries, uint32_t keep) const {
+            if (heap[0] != keep) {
+                return heap[0];
+            }
+            return heap.size() > 2 && heap_key(entries, 2) > heap_key(entries, 1) ? heap[2] : heap[1];
+        }
+
+        void erase(std::vector<Entry>& entries, uint32_t slot, bool) {
+            auto pos = entries[slot].heap_pos;
+            auto last = static_cast<uint32_t>(heap.size() - 1);
+            heap_swap(entries, pos, last);
+            heap.pop_back();
+            if (pos != last) {
+                sift_down(entries, pos);
+                sift_up(entries, pos);
+            }
+        }
+
+    private:
+        // next_use of the heap element, slab_npos (never used again) is the largest one
+        uint32_t heap_key(const std::vector<Entry>& entries, uint32_t pos) const { return entries[heap[pos]].next_use; }
+        uint32_t consume();
+        void heap_swap(std::vector<Entry>& entries, uint32_t a, uint32_t b);
+        void sift_up(std::vector<Entry>& entries, uint32_t pos);
+        void sift_down(std::vector<Entry>& entries, uint32_t pos);
 
-    std::list<std::pair<int, int>> cache;
-    std::unordered_map<int, ListIt> hash;
+        std::vector<uint32_t> next_use;
+        std::size_t position = 0;
+        uint32_t current = 0;
+        uint32_t missed_position = slab_npos;
+        std::vector<uint32_t> heap;  // slots, the furthest next use on top
+    };
 
-    std::unordered_map<int, std::list<int>> distances;
-    std::set<std::pair<int, int>> max_distances;
-    int capacity;
+private:
+    std::vector<uint32_t> next_use;
 };
+
+// Index maps keys to slots: SlabIndex (chained) or FlatIndex (open addressing).
+template<class K = int, class V = int, class Hash = std::hash<K>, class Index = SlabIndex<K, Hash>>
+using PerfectCache = Cache<K, V, PerfectPolicy<K, Hash>, Index>;
+
+template<class K, class Hash>
+PerfectPolicy<K, Hash>::PerfectPolicy(const std::vector<K>& keys) : next_use(keys.size()) {
+    if (keys.size() >= slab_npos) {
+        throw std::length_error("Trace doesn't fit into 32-bit positions");
+    }
+    std::unordered_map<K, uint32_t, Hash> seen;
+    for (auto i = keys.size(); i-- > 0;) {
+        auto [it, inserted] = seen.try_emplace(keys[i], static_cast<uint32_t>(i));
+        next_use[i] = inserted ? slab_npos : it->second;
+        it->second = static_cast<uint32_t>(i);
+    }
+}
+
+template<class K, class Hash>
+PerfectPolicy<K, Hash>::PerfectPolicy(const std::vector<K>& keys, std::size_t universe) : next_use(keys.size()) {
+    if (keys.size() >= slab_npos) {
+        throw std::length_error("Trace doesn't fit into 32-bit positions");
+    }
+    std::vector<uint32_t> seen(universe, slab_npos);
+    for (auto i = keys.size(); i-- > 0;) {
+        auto& last = seen.at(static_cast<std::size_t>(keys[i]));
+        next_use[i] = last;
+        last = static_cast<uint32_t>(i);
+    }
+}
+
+template<class K, class Hash>
+template<class Entry>
+uint32_t PerfectPolicy<K, Hash>::Order<Entry>::consume() {
+    if (position == next_use.size()) {
+        throw std::logic_error("Perfect cache trace is over");
+    }
+    return static_cast<uint32_t>(position++);
+}
+
+template<class K, class Hash>
+template<class Entry>
+void PerfectPolicy<K, Hash>::Order<Entry>::heap_swap(std::vector<Entry>& entries, uint32_t a, uint32_t b) {
+    std::swap(heap[a], heap[b]);
+    entries[heap[a]].heap_pos = a;
+    entries[heap[b]].heap_pos = b;
+}
+
+template<class K, class Hash>
+template<class Entry>
+void PerfectPolicy<K, Hash>::Order<Entry>::sift_up(std::vector<Entry>& entries, uint32_t pos) {
+    while (pos > 0) {
+        auto parent = (pos - 1) / 2;
+        if (heap_key(entries, parent) >= heap_key(entries, pos)) {
+            break;
+        }
+        heap_swap(entries, parent, pos);
+        pos = parent;
+    }
+}
+
+template<class K, class Hash>
+template<class Entry>
+void PerfectPolicy<K, Hash>::Order<Entry>::sift_down(std::vector<Entry>& entries, uint32_t pos) {
+    auto n = static_cast<uint32_t>(heap.size());
+    while (true) {
+        auto largest = pos;
+        auto left = 2 * pos + 1;
+        auto right = left + 1;
+        if (left < n && heap_key(entries, left) > heap_key(entries, largest)) {
+            largest = left;
+        }
+        if (right < n && heap_key(entries, right) > heap_key(entries, largest)) {
+            largest = right;
+        }
+        if (largest == pos) {
+            break;
+        }
+        heap_swap(entries, pos, largest);
+        pos = largest;
+    }
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include "arc.hpp"
+#include "clock.hpp"
+#include "clock_pro.hpp"
+#include "dense_index.hpp"
+#include "lfu.hpp"
+#include "lru.hpp"
+#include "perfect_cache.hpp"
+#include "tinylfu.hpp"
+#include "trace_format.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Replay of one trace through many (policy, capacity) configurations at once.
+// Every worker thread takes the next configuration from a shared counter and replays the whole trace
+// through its own cache: the trace is only read, so the workers share it without any other synchronisation.
+// Policies: lru, lfu, lfu_da (LFU with dynamic aging), arc, tinylfu, clock, clockpro and perfect
+// (Belady, offline optimal).
+// A trace remapped to dense keys (remap_dense()) is replayed in the simulation mode, where the LRU, LFU
+// and perfect caches index their entries by the key itself instead of hashing it.
+// A binary trace is replayed straight from its mapping (TraceReader::for_each()), only the perfect
+// policy decodes it into memory: it needs every next use up front.
+
+struct ReplayConfig {
+    std::string policy;
+    std::size_t capacity;
+};
+
+inline const std::vector<std::string>& replay_policies() {
+    static const std::vector<std::string> policies = {"lru", "lfu", "lfu_da", "arc", "tinylfu", "clock", "clockpro", "perfect"};
+    return policies;
+}
+
+// calls f(key) for every request of a trace in memory or in a binary trace file
+template<class K, class F>
+void for_each_key(const std::vector<K>& trace, F&& f) {
+    for (auto k : trace) {
+        f(k);
+    }
+}
+
+template<class F>
+void for_each_key(const TraceReader& trace, F&& f) {
+    trace.for_each(f);
+}
+
+template<class K>
+const std::vector<K>& trace_keys(const std::vector<K>& trace) {
+    return trace;
+}
+
+inline std::vector<int> trace_keys(const TraceReader& trace) {
+    return trace.keys();
+}
+
+template<class Cache, class Trace>
+std::size_t access_hits(Cache& cache, const Trace& trace) {
+    std::size_t hits = 0;
+    for_each_key(trace, [&cache, &hits](auto k) {
+        if (cache.access(k, [k] { return k; }).second) {
+            ++hits;
+        }
+    });
+    return hits;
+}
+
+// LRU, LFU and perfect caches over the given key index, the others keep their own hash maps.
+// With dense keys the universe is passed too: their indexes and the perfect policy are sized for it
+// before the replay starts.
+template<class K, class Index, class Trace, class... Universe>
+std::size_t replay_hits(const ReplayConfig& config, const Trace& trace, Universe... universe) {
+    using Hash = std::hash<K>;
+    const auto& policy = config.policy;
+    if (policy == "lru") {
+        LRUCache<K, K, Hash, Index> cache(config.capacity);
+        (cache.reserve_index(universe), ...);
+        return access_hits(cache, trace);
+    }
+    if (policy == "lfu" || policy == "lfu_da") {
+        LFUCache<K, K, Hash, Index> cache(config.capacity, policy == "lfu" ? LFUAging::none : LFUAging::dynamic);
+        (cache.reserve_index(universe), ...);
+        return access_hits(cache, trace);
+    }
+    if (policy == "arc") {
+        ARCCache<K, K> cache(config.capacity);
+        return access_hits(cache, trace);
+    }
+    if (policy == "tinylfu") {
+        TinyLFUCache<K, K> cache(config.capacity);
+        return access_hits(cache, trace);
+    }
+    if (policy == "clock") {
+        ClockCache<K, K> cache(config.capacity);
+        return access_hits(cache, trace);
+    }
+    if (policy == "clockpro") {
+        ClockProCache<K, K> cache(config.capacity);
+        return access_hits(cache, trace);
+    }
+    if (policy == "perfect") {
+        const auto& keys = trace_keys(trace);
+        PerfectCache<K, K, Hash, Index> cache(config.capacity, PerfectPolicy<K, Hash>(keys, universe...));
+        (cache.reserve_index(universe), ...);
+        return access_hits(cache, keys);
+    }
+    throw std::invalid_argument("Unknown policy " + policy);
+}
+
+inline std::size_t replay_hits(const ReplayConfig& config, const std::vector<int>& trace) {
+    return replay_hits<int, SlabIndex<int>>(config, trace);
+}
+
+inline std::size_t replay_hits(const ReplayConfig& config, const TraceReader& trace) {
+    return replay_hits<int, SlabIndex<int>>(config, trace);
+}
+
+// the simulation mode: the caches index flat arrays by the dense keys (see DenseIndex)
+inline std::size_t replay_hits(const ReplayConfig& config, const DenseTrace& trace) {
+    return replay_hits<uint32_t, DenseIndex<uint32_t>>(config, trace.keys, trace.universe);
+}
+
+// hits of every configuration, in the order of configs; rethrows the first failure of a worker
+template<class Trace>
+std::vector<std::size_t> replay_parallel(const Trace& trace, const std::vector<ReplayConfig>& configs,
+    unsigned threads = std::thread::hardware_concurrency()) {
+    for (auto& config : configs) {
+        if (std::find(replay_policies().begin(), replay_policies().end(), config.policy) == replay_policies().end()) {
+            throw std::invalid_argument("Unknown policy " + config.policy);
+        }
+    }
+    std::vector<std::size_t> hits(configs.size());
+    std::vector<std::exception_ptr> errors(configs.size());
+    std::atomic<std::size_t> next{0};
+    auto work = [&] {
+        for (auto i = next.fetch_add(1); i < configs.size(); i = next.fetch_add(1)) {
+            try {
+                hits[i] = replay_hits(configs[i], trace);
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+
+    threads = static_cast<unsigned>(std::min<std::size_t>(std::max(threads, 1u), configs.size()));
+    std::vector<std::thread> workers;
+    for (unsigned t = 1; t < threads; ++t) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return hits;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "lru.hpp"
+#include "sharding.hpp"
+
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+// Thread-safe LRU made of independently locked LRUCache shards, the shard is picked by key hash.
+// Recency is tracked per shard, so eviction is LRU within a shard only.
+template<class K = int, class V = int, class Hash = std::hash<K>>
+class ShardedLRUCache {
+public:
+    ShardedLRUCache(std::size_t shards_count, std::size_t shard_capacity) : shards(make_shards<Shard>(shards_count)) {
+        for (auto& s : shards) {
+            s.cache = LRUCache<K, V, Hash>(shard_capacity);
+        }
+    }
+
+    std::size_t shards_count() const { return shards.size(); }
+    std::size_t size() const;
+
+    // returns -1 (V{} for non-arithmetic values) on a miss like LRUCache::get
+    V get(const K& key);
+    std::optional<V> find(const K& key);
+    void put(const K& key, const V& value);
+
+private:
+    // cache line sized so that neighbouring shard locks don't share a line
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        LRUCache<K, V, Hash> cache;
+    };
+
+    Shard& shard(const K& key) { return pick_shard(shards, hasher, key); }
+
+    std::vector<Shard> shards;
+    Hash hasher;
+};
+
+template<class K, class V, class Hash>
+std::size_t ShardedLRUCache<K, V, Hash>::size() const {
+    std::size_t total = 0;
+    for (auto& s : shards) {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        total += s.cache.size();
+    }
+    return total;
+}
+
+template<class K, class V, class Hash>
+V ShardedLRUCache<K, V, Hash>::get(const K& key) {
+    auto& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return s.cache.get(key);
+}
+
+template<class K, class V, class Hash>
+std::optional<V> ShardedLRUCache<K, V, Hash>::find(const K& key) {
+    auto& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (auto* value = s.cache.find(key)) {
+        return *value;
+    }
+    return std::nullopt;
+}
+
+template<class K, class V, class Hash>
+void ShardedLRUCache<K, V, Hash>::put(const K& key, const V& value) {
+    auto& s = shard(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.cache.put(key, value);
+}
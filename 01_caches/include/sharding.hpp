@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+// Helpers of the sharded thread-safe caches (ShardedLRUCache, ClockCache, ClockProCache, LoadingCache,
+// FrontCache): every cache picks a key's shard the same way.
+
+// the key's hash mixed for picking shards: a different multiplier than SlabIndex uses for buckets,
+// otherwise all keys of a shard would land in the same part of its index
+inline uint64_t shard_hash(uint64_t h) {
+    return h * 0xC2B2AE3D27D4EB4Full;
+}
+
+// the shard of a shard_hash(), from its high bits (the low ones are free for other uses, see FrontCache)
+inline std::size_t shard_index(uint64_t mixed, std::size_t shards_count) {
+    return static_cast<std::size_t>(mixed >> 32) % shards_count;
+}
+
+template<class Shard, class Hash, class K>
+Shard& pick_shard(std::vector<Shard>& shards, const Hash& hasher, const K& key) {
+    return shards[shard_index(shard_hash(static_cast<uint64_t>(hasher(key))), shards.size())];
+}
+
+template<class Shard>
+std::vector<Shard> make_shards(std::size_t shards_count) {
+    if (shards_count == 0) {
+        throw std::invalid_argument("Sharded cache needs at least one shard");
+    }
+    return std::vector<Shard>(shards_count);
+}
+
+// sets the reference bit of a CLOCK entry on a hit under the shared lock: a hot entry's bit is
+// already set, reading first keeps its cache line shared between readers
+inline void set_referenced(std::atomic<uint8_t>& referenced) {
+    if (referenced.load(std::memory_order_relaxed) == 0) {
+        referenced.store(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,138 @@
+#pragma once
+#include "avl_tree/avl_tree.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// SHARDS (Waldspurger et al.): spatially hashed sampling of a trace.
+// A key is sampled iff spread(hash(key)) mod P < T, so either every access of a key is
+// simulated or none is, and the sampled trace behaves like the full one scaled by R = T / P.
+template<class K, class Hash = std::hash<K>>
+class ShardsSampler {
+public:
+    static constexpr uint64_t modulus = uint64_t{1} << 24;
+
+    ShardsSampler(double rate) : threshold(static_cast<uint64_t>(std::llround(rate * modulus))) {
+        if (rate <= 0 || rate > 1) {
+            throw std::invalid_argument("Sampling rate should be in (0, 1]");
+        }
+    }
+
+    // position of the key in [0, modulus)
+    uint64_t value(const K& key) const {
+        // splitmix64 finalizer: std::hash of integers is often the identity
+        uint64_t x = static_cast<uint64_t>(hasher(key));
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return x % modulus;
+    }
+
+    bool sampled(const K& key) const { return value(key) < threshold; }
+    double rate() const { return static_cast<double>(threshold) / modulus; }
+
+    // fixed-size sampling lowers the threshold to drop the keys with the largest values
+    void lower_threshold(uint64_t t) { threshold = std::min(threshold, t); }
+
+private:
+    uint64_t threshold;
+    Hash hasher;
+};
+
+// Estimated LRU hits for every capacity, hits[c] for c in [0, max_capacity], from the
+// stack distances of the sampled accesses only (see lru_hits_curve() in mrc.hpp).
+// A distance d measured in the sampled trace stands for d / R in the full one, so the curve
+// says nothing about capacities below 1 / R: hits[c] there is only the SHARDS_adj term below.
+// It takes a sample of about 2000 distinct keys at least, even then the error is 15-25%.
+// With max_samples > 0 at most max_samples keys are tracked: when there are more, the
+// threshold goes down to the largest tracked value and the keys with it are forgotten,
+// so memory doesn't depend on the trace.
+//
+// Every sampled access stands for 1 / R accesses of the full trace (R at the moment of the access).
+// A few very hot keys make the sampled accesses deviate from N in total, SHARDS_adj attributes
+// the difference to the smallest reuse distances, i.e. counts it as hits.
+template<class K, class Hash = std::hash<K>>
+std::vector<uint64_t> shards_hits_curve(const std::vector<K>& keys, std::size_t max_capacity,
+    double rate, std::size_t max_samples = 0) {
+    if (keys.size() > static_cast<std::size_t>(std::numeric_limits<int>::max())) {
+        throw std::length_error("Trace doesn't fit into int timestamps");
+    }
+    ShardsSampler<K, Hash> sampler(rate);
+    std::vector<double> histogram(max_capacity + 1, 0);
+    std::unordered_map<K, int, Hash> last_access;
+    std::priority_queue<std::pair<uint64_t, K>> tracked;  // largest value on top
+    AVLTree<int> times;
+    double weight = 1 / sampler.rate(), total_weight = 0;
+    int distinct = 0;
+    int t = 0;
+    for (const auto& key : keys) {
+        if (!sampler.sampled(key)) {
+            continue;
+        }
+        total_weight += weight;
+        auto [it, inserted] = last_access.try_emplace(key, t);
+        if (inserted) {
+            ++distinct;
+            tracked.emplace(sampler.value(key), key);
+        } else {
+            auto prev = it->second;
+            auto distance = (distinct - times.less_count(prev)) / sampler.rate();
+            auto c = static_cast<std::size_t>(std::ceil(distance));
+            if (c <= max_capacity) {
+                histogram[c] += weight;
+            }
+            times.erase(prev);
+            it->second = t;
+        }
+        times.insert(t++);
+
+        if (max_samples > 0 && last_access.size() > max_samples) {
+            auto top = tracked.top().first;
+            sampler.lower_threshold(top);
+            weight = 1 / sampler.rate();
+            while (!tracked.empty() && tracked.top().first == top) {
+                auto dropped = last_access.find(tracked.top().second);
+                times.erase(dropped->second);
+                last_access.erase(dropped);
+                --distinct;
+                tracked.pop();
+            }
+        }
+    }
+
+    std::vector<uint64_t> hits(max_capacity + 1, 0);
+    double sum = keys.size() - total_weight;
+    for (std::size_t c = 1; c <= max_capacity; ++c) {
+        sum += histogram[c];
+        hits[c] = static_cast<uint64_t>(std::llround(std::max(sum, 0.0)));
+    }
+    return hits;
+}
+
+// Hits of a cache simulated on the sampled keys only with capacity scaled by R,
+// rescaled to the full trace (with the SHARDS_adj correction as above). Works for any cache constructible from a capacity.
+template<class Cache, class K, class Hash = std::hash<K>>
+uint64_t shards_hits(const std::vector<K>& keys, std::size_t capacity, double rate) {
+    ShardsSampler<K, Hash> sampler(rate);
+    Cache cache(static_cast<std::size_t>(std::llround(capacity * sampler.rate())));
+    uint64_t hits = 0, sampled_accesses = 0;
+    for (const auto& key : keys) {
+        if (!sampler.sampled(key)) {
+            continue;
+        }
+        ++sampled_accesses;
+        if (cache.access(key, [&key] { return key; }).second) {
+            ++hits;
+        }
+    }
+    auto adjusted = (hits + keys.size() * sampler.rate() - sampled_accesses) / sampler.rate();
+    return static_cast<uint64_t>(std::llround(std::max(adjusted, 0.0)));
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Building blocks for caches that keep their entries in a preallocated slab
+// (std::vector of nodes) and refer to them by 32-bit slot numbers instead of pointers.
+// Once the slab is filled nothing is allocated anymore: evicted slots are reused.
+
+constexpr uint32_t slab_npos = std::numeric_limits<uint32_t>::max();
+
+inline void check_slab_capacity(std::size_t capacity) {
+    if (capacity >= slab_npos) {
+        throw std::length_error("Cache capacity doesn't fit into 32-bit slot numbers");
+    }
+}
+
+// Value the caches' get() returns on a miss: -1 for arithmetic values (as the int caches always did),
+// V{} otherwise. find() is the way to tell a miss from a cached value.
+template<class V>
+V cache_miss_value() {
+    if constexpr (std::is_arithmetic<V>::value) {
+        return V(-1);
+    } else {
+        return V{};
+    }
+}
+
+struct SlabLinks {
+    uint32_t prev = slab_npos;
+    uint32_t next = slab_npos;
+};
+
+// Intrusive doubly linked list threaded through the SlabLinks member of slab nodes.
+template<class Node, SlabLinks Node::*Links = &Node::links>
+class SlabList {
+public:
+    uint32_t front() const { return head; }
+    uint32_t back() const { return tail; }
+    uint32_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    void push_front(std::vector<Node>& nodes, uint32_t slot) {
+        auto& l = nodes[slot].*Links;
+        l.prev = slab_npos;
+        l.next = head;
+        if (head != slab_npos) {
+            (nodes[head].*Links).prev = slot;
+        } else {
+            tail = slot;
+        }
+        head = slot;
+        ++count;
+    }
+
+    void push_back(std::vector<Node>& nodes, uint32_t slot) {
+        if (tail == slab_npos) {
+            push_front(nodes, slot);
+        } else {
+            insert_after(nodes, tail, slot);
+        }
+    }
+
+    void insert_after(std::vector<Node>& nodes, uint32_t pos, uint32_t slot) {
+        auto& p = nodes[pos].*Links;
+        auto& l = nodes[slot].*Links;
+        l.prev = pos;
+        l.next = p.next;
+        if (p.next != slab_npos) {
+            (nodes[p.next].*Links).prev = slot;
+        } else {
+            tail = slot;
+        }
+        p.next = slot;
+        ++count;
+    }
+
+    void unlink(std::vector<Node>& nodes, uint32_t slot) {
+        auto& l = nodes[slot].*Links;
+        if (l.prev != slab_npos) {
+            (nodes[l.prev].*Links).next = l.next;
+        } else {
+            head = l.next;
+        }
+        if (l.next != slab_npos) {
+            (nodes[l.next].*Links).prev = l.prev;
+        } else {
+            tail = l.prev;
+        }
+        l.prev = l.next = slab_npos;
+        --count;
+    }
+
+    void move_front(std::vector<Node>& nodes, uint32_t slot) {
+        if (slot != head) {
+            unlink(nodes, slot);
+            push_front(nodes, slot);
+        }
+    }
+
+    void clear() {
+        head = tail = slab_npos;
+        count = 0;
+    }
+
+private:
+    uint32_t head = slab_npos;
+    uint32_t tail = slab_npos;
+    uint32_t count = 0;
+};
+
+// Fixed-size chained hash index: key -> slot.
+// Bucket heads and chain links are plain arrays of slot numbers sized once at construction,
+// the keys themselves stay in the slab and are reached through the key_at callback.
+template<class K, class Hash = std::hash<K>>
+class SlabIndex {
+public:
+    SlabIndex(std::size_t capacity = 0) : chain(capacity, slab_npos) {
+        int bits = 1;
+        while ((std::size_t{1} << bits) < capacity) {
+            ++bits;
+        }
+        shift = 64 - bits;
+        buckets.assign(std::size_t{1} << bits, slab_npos);
+    }
+
+    template<class KeyAt>
+    uint32_t find(const K& key, KeyAt&& key_at) const {
+        return find_in(bucket(key), key, key_at);
+    }
+
+    void insert(const K& key, uint32_t slot) {
+        insert_in(bucket(key), slot);
+    }
+
+    // find_in/insert_in take the bucket computed once, so a find-or-insert hashes the key once
+    std::size_t bucket(const K& key) const {
+        return bucket_of(hash(key));
+    }
+
+    // a restored snapshot keeps the key hashes and gets the buckets without hashing the keys
+    uint64_t hash(const K& key) const { return static_cast<uint64_t>(hasher(key)); }
+    std::size_t bucket_of(uint64_t hash) const {
+        // fibonacci hashing: spreads identity-like std::hash values over all buckets
+        return (hash * 0x9E3779B97F4A7C15ull) >> shift;
+    }
+
+    template<class KeyAt>
+    uint32_t find_in(std::size_t bucket, const K& key, KeyAt&& key_at) const {
+        for (auto slot = buckets[bucket]; slot != slab_npos; slot = chain[slot]) {
+            if (key_at(slot) == key) {
+                return slot;
+            }
+        }
+        return slab_npos;
+    }
+
+    void insert_in(std::size_t bucket, uint32_t slot) {
+        chain[slot] = buckets[bucket];
+        buckets[bucket] = slot;
+    }
+
+    void erase(const K& key, uint32_t slot) {
+        auto* link = &buckets[bucket(key)];
+        while (*link != slot) {
+            link = &chain[*link];
+        }
+        *link = chain[slot];
+        chain[slot] = slab_npos;
+    }
+
+private:
+    std::vector<uint32_t> buckets;
+    std::vector<uint32_t> chain;
+    int shift = 63;
+    Hash hasher;
+};
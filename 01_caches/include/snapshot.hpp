@@ -0,0 +1,129 @@
+#pragma once
+#include "mapped_file.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary snapshot of a cache: a header followed by fixed-size records from the entry the cache would evict
+// last (LRU: from the most recent entry, LFU: from the most frequent bucket, each from its most recent entry),
+// so a smaller cache restores the prefix.
+// A record keeps the key hash, so a restore fills the index without hashing the keys again; a snapshot
+// must be restored with the same Hash (checked on the first record). Keys and values are stored as raw
+// bytes and have to be trivially copyable. TTL deadlines aren't saved, restored entries never expire.
+
+enum class SnapshotKind : uint32_t {
+    lru = 1,
+    lfu = 2
+};
+
+struct SnapshotHeader {
+    uint64_t magic = 0x504E534548434143ull;  // "CACHESNP"
+    uint32_t version = 2;
+    SnapshotKind kind = SnapshotKind::lru;
+    uint32_t key_size = 0;
+    uint32_t value_size = 0;
+    uint64_t count = 0;
+    uint64_t age = 0;  // LFU-DA age
+};
+
+template<class K, class V>
+struct SnapshotRecord {
+    uint64_t hash;
+    uint64_t freq;      // LFU frequency
+    uint64_t priority;  // LFU priority, the frequency plus the age of its last hit with dynamic aging
+    K key;
+    V value;
+    uint32_t weight;
+};
+
+template<class K, class V>
+class SnapshotWriter {
+public:
+    static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                  "Snapshots store keys and values as raw bytes");
+
+    SnapshotWriter(const std::string& path, SnapshotKind kind, uint64_t count, uint64_t age = 0)
+        : out(path, std::ios::binary | std::ios::trunc) {
+        if (!out) {
+            throw std::runtime_error("Can't open snapshot file " + path);
+        }
+        SnapshotHeader header;
+        header.kind = kind;
+        header.key_size = sizeof(K);
+        header.value_size = sizeof(V);
+        header.count = count;
+        header.age = age;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        buffer.reserve(buffer_records);
+    }
+
+    void write(const SnapshotRecord<K, V>& record) {
+        buffer.push_back(record);
+        if (buffer.size() == buffer_records) {
+            flush();
+        }
+    }
+
+    // throws if anything failed to be written
+    void finish() {
+        flush();
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("Failed to write snapshot");
+        }
+    }
+
+private:
+    static constexpr std::size_t buffer_records = 1 << 14;
+
+    void flush() {
+        out.write(reinterpret_cast<const char*>(buffer.data()),
+                  static_cast<std::streamsize>(buffer.size() * sizeof(SnapshotRecord<K, V>)));
+        buffer.clear();
+    }
+
+    std::ofstream out;
+    std::vector<SnapshotRecord<K, V>> buffer;
+};
+
+// Maps the whole snapshot read-only, records are read straight from the page cache.
+template<class K, class V>
+class SnapshotReader {
+public:
+    static_assert(std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value,
+                  "Snapshots store keys and values as raw bytes");
+
+    SnapshotReader(const std::string& path, SnapshotKind kind) : file(path) {
+        if (file.size() < sizeof(SnapshotHeader)) {
+            throw std::runtime_error("Snapshot file " + path + " is truncated");
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        SnapshotHeader expected;
+        if (header.magic != expected.magic || header.version != expected.version || header.kind != kind ||
+            header.key_size != sizeof(K) || header.value_size != sizeof(V)) {
+            throw std::runtime_error("Snapshot file " + path + " doesn't match the cache type");
+        }
+        if ((file.size() - sizeof(header)) / sizeof(SnapshotRecord<K, V>) < header.count) {
+            throw std::runtime_error("Snapshot file " + path + " is truncated");
+        }
+    }
+
+    std::size_t size() const { return header.count; }
+    uint64_t age() const { return header.age; }
+
+    SnapshotRecord<K, V> operator[](std::size_t i) const {
+        // the mapping is only 8-byte aligned past the header, copying also suits any K and V alignment
+        SnapshotRecord<K, V> record;
+        std::memcpy(&record, file.data() + sizeof(header) + i * sizeof(record), sizeof(record));
+        return record;
+    }
+
+private:
+    MappedFile file;
+    SnapshotHeader header;
+};
@@ -0,0 +1,229 @@
+#pragma once
+#include "file_store.hpp"
+#include "lru.hpp"
+#include "write_back.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct TierStats {
+    uint64_t memory_hits = 0;
+    uint64_t disk_hits = 0;  // reads queued or joined
+    uint64_t misses = 0;
+};
+
+// Two-tier cache for working sets bigger than memory: an LRU in memory over an append-only log of
+// entries on local disk with an in-memory index (FileStore). An entry evicted from memory is demoted:
+// WriteBackCache's background thread appends it to the log in batches, unless the log already has
+// its value (it came from the log and wasn't changed since).
+// get() doesn't wait for the disk: a memory hit is a ready future, a key only the log has is queued to
+// the I/O threads, which pread() its record and promote it back into memory, then the future is ready.
+// Concurrent gets of a key being read share the read. A put() while it's in flight wins over it: the read
+// returns the value put, or reads the log again if that value already went there.
+//
+// Thread-safe: the memory tier is behind one lock, disk reads and writes (and flush() waiting for them)
+// run without it.
+// The log outlives the cache, a new one on the same file serves what the old one demoted or flushed.
+// The disk tier is a Store with load(), contains(), store() and size() like FileStore's.
+template<class K = int, class V = int, class Hash = std::hash<K>, class Store = FileStore<K, V, Hash>>
+class TieredCache {
+public:
+    using Result = std::shared_future<std::optional<V>>;
+
+    // the log in the file at path
+    TieredCache(std::size_t memory_capacity, const std::string& path, std::size_t io_threads = 2,
+        std::size_t batch_size = 256, bool sync = false);
+    // the store has to outlive the cache
+    TieredCache(std::size_t memory_capacity, Store& store, std::size_t io_threads = 2, std::size_t batch_size = 256);
+    TieredCache(const TieredCache&) = delete;
+    TieredCache& operator=(const TieredCache&) = delete;
+    ~TieredCache();
+
+    // nullopt if neither tier has the key
+    Result get(const K& key);
+    void put(const K& key, const V& value);
+    // writes the demoted entries and the changed ones still in memory to the log and waits for it
+    void flush();
+
+    std::size_t memory_size() const;
+    // keys in the log
+    std::size_t disk_size() const { return store.size(); }
+    TierStats stats() const;
+
+private:
+    struct Read {
+        K key;
+        std::promise<std::optional<V>> promise;
+    };
+
+    struct Reading {
+        Result result;
+        bool written = false;  // put() since the read was queued
+    };
+
+    static Result ready(std::optional<V> value) {
+        std::promise<std::optional<V>> promise;
+        promise.set_value(std::move(value));
+        return promise.get_future().share();
+    }
+
+    void start(std::size_t io_threads);
+    void io_loop();
+
+    std::optional<Store> own_store;
+    Store& store;
+    mutable std::mutex mutex;  // everything below
+    WriteBackCache<K, V, Store, LRUPolicy, Hash> memory;
+    std::unordered_map<K, Reading, Hash> reading;
+    std::deque<Read> queue;
+    std::condition_variable wake;
+    bool stopping = false;
+    TierStats statistics;
+    std::vector<std::thread> io;
+};
+
+template<class K, class V, class Hash, class Store>
+TieredCache<K, V, Hash, Store>::TieredCache(std::size_t memory_capacity, const std::string& path,
+    std::size_t io_threads, std::size_t batch_size, bool sync)
+    : own_store(std::in_place, path, sync), store(*own_store), memory(memory_capacity, store, batch_size) {
+    start(io_threads);
+}
+
+template<class K, class V, class Hash, class Store>
+TieredCache<K, V, Hash, Store>::TieredCache(std::size_t memory_capacity, Store& store, std::size_t io_threads,
+    std::size_t batch_size)
+    : store(store), memory(memory_capacity, store, batch_size) {
+    start(io_threads);
+}
+
+template<class K, class V, class Hash, class Store>
+void TieredCache<K, V, Hash, Store>::start(std::size_t io_threads) {
+    for (std::size_t i = 0; i < std::max<std::size_t>(io_threads, 1); ++i) {
+        io.emplace_back([this] { io_loop(); });
+    }
+}
+
+template<class K, class V, class Hash, class Store>
+TieredCache<K, V, Hash, Store>::~TieredCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    // the queued reads are served first, the memory tier is flushed to the log after
+    for (auto& t : io) {
+        t.join();
+    }
+}
+
+template<class K, class V, class Hash, class Store>
+typename TieredCache<K, V, Hash, Store>::Result TieredCache<K, V, Hash, Store>::get(const K& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (auto value = memory.find(key)) {
+        ++statistics.memory_hits;
+        return ready(std::move(value));
+    }
+    if (auto it = reading.find(key); it != reading.end()) {
+        ++statistics.disk_hits;
+        return it->second.result;
+    }
+    // a victim leaves the write-back queue once the log's index has it: one of the two is checked
+    if (!store.contains(key)) {
+        ++statistics.misses;
+        return ready(std::nullopt);
+    }
+    ++statistics.disk_hits;
+    Read read{key, {}};
+    auto result = read.promise.get_future().share();
+    reading.emplace(key, Reading{result});
+    queue.push_back(std::move(read));
+    wake.notify_one();
+    return result;
+}
+
+template<class K, class V, class Hash, class Store>
+void TieredCache<K, V, Hash, Store>::put(const K& key, const V& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    memory.put(key, value);
+    if (auto it = reading.find(key); it != reading.end()) {
+        it->second.written = true;
+    }
+}
+
+template<class K, class V, class Hash, class Store>
+void TieredCache<K, V, Hash, Store>::flush() {
+    uint64_t target;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        target = memory.start_flush();
+    }
+    // gets and puts go on while the log is written
+    memory.wait_flushed(target);
+}
+
+template<class K, class V, class Hash, class Store>
+std::size_t TieredCache<K, V, Hash, Store>::memory_size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return memory.size();
+}
+
+template<class K, class V, class Hash, class Store>
+TierStats TieredCache<K, V, Hash, Store>::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return statistics;
+}
+
+template<class K, class V, class Hash, class Store>
+void TieredCache<K, V, Hash, Store>::io_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) {
+            return;
+        }
+        auto read = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+        std::optional<V> value;
+        std::exception_ptr failure;
+        try {
+            value = store.load(read.key);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        lock.lock();
+        auto it = reading.find(read.key);
+        if (failure) {
+            reading.erase(it);
+            read.promise.set_exception(failure);
+            continue;
+        }
+        if (it->second.written) {
+            // a put() since the read was queued is newer than what was read: the memory tier has it,
+            // or it was demoted (flushed) to the log meanwhile and the key is read again
+            if (auto newer = memory.find(read.key)) {
+                value = std::move(newer);
+            } else {
+                it->second.written = false;
+                queue.push_back(std::move(read));
+                continue;
+            }
+        } else if (value) {
+            memory.promote(read.key, *value);
+        }
+        reading.erase(it);
+        read.promise.set_value(std::move(value));
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include "slab.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+// Time-to-live of an entry that never expires.
+constexpr uint64_t no_ttl = std::numeric_limits<uint64_t>::max();
+
+// Time source of the expiring caches in ticks, TTLs are given in the same ticks.
+// Tests inject their own clock to replay traces deterministically.
+using CacheClock = std::function<uint64_t()>;
+
+inline uint64_t steady_clock_ms() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+}
+
+// Hierarchical timing wheel (Varghese, Lauck) over slab slots.
+// Level l has 64 buckets of 64^l ticks each, a timer goes to the lowest level whose span covers
+// its remaining time, timers beyond the top level wait in it and are rescheduled when reached.
+// Advancing the clock visits at most 64 buckets per level whatever the elapsed time: expired timers
+// are reported, the others cascade to lower levels, so every timer is touched O(levels) times.
+// The timers (one per slot) and the 384 bucket heads are allocated on the first schedule(): until then
+// the wheel is a few words, a cache without TTLs only pays for those and its clock (see Cache).
+class TimingWheel {
+public:
+    TimingWheel(std::size_t capacity = 0) : capacity(capacity) {}
+
+    bool empty() const { return scheduled == 0; }
+    uint64_t now() const { return current; }
+
+    // the wheel must have been advanced to the current time
+    void schedule(uint32_t slot, uint64_t expires_at) {
+        if (timers.empty()) {
+            timers.resize(capacity);
+            buckets.resize(levels * slots);
+        }
+        timers[slot].expires_at = expires_at;
+        place(slot);
+        ++scheduled;
+    }
+
+    void cancel(uint32_t slot) {
+        if (timers.empty() || timers[slot].bucket == slab_npos) {
+            return;
+        }
+        buckets[timers[slot].bucket].unlink(timers, slot);
+        timers[slot].bucket = slab_npos;
+        --scheduled;
+    }
+
+    // calls expire(slot) for every timer with expires_at <= now, the timer is already cancelled then
+    // (expire must not cancel other timers)
+    template<class F>
+    void advance(uint64_t now, F&& expire) {
+        if (now <= current) {
+            return;
+        }
+        auto previous = current;
+        current = now;
+        if (scheduled == 0) {
+            return;
+        }
+        for (int level = 0; level < levels; ++level) {
+            auto from = previous >> (level * bits), to = now >> (level * bits);
+            if (from == to) {
+                break;
+            }
+            auto passed = std::min<uint64_t>(to - from, slots);
+            for (uint64_t tick = to - passed + 1; tick <= to; ++tick) {
+                // detached first: a top level timer that isn't due yet may go back to the same bucket
+                auto bucket = buckets[level * slots + (tick & (slots - 1))];
+                buckets[level * slots + (tick & (slots - 1))].clear();
+                while (!bucket.empty()) {
+                    auto slot = bucket.front();
+                    bucket.unlink(timers, slot);
+                    if (timers[slot].expires_at <= now) {
+                        timers[slot].bucket = slab_npos;
+                        --scheduled;
+                        expire(slot);
+                    } else {
+                        place(slot);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr int bits = 6;
+    static constexpr uint64_t slots = uint64_t{1} << bits;
+    static constexpr int levels = 6;  // 2^36 ticks, a bit over 2 years of milliseconds
+
+    struct Timer {
+        SlabLinks links;
+        uint64_t expires_at = 0;
+        uint32_t bucket = slab_npos;
+    };
+
+    // the bucket covering expires_at at the lowest level that spans the remaining time,
+    // an already expired timer goes to the next tick
+    void place(uint32_t slot) {
+        auto expires_at = std::max(timers[slot].expires_at, current + 1);
+        auto remaining = expires_at - current;
+        int level = 0;
+        while (level + 1 < levels && remaining >= (uint64_t{1} << ((level + 1) * bits))) {
+            ++level;
+        }
+        auto b = static_cast<uint32_t>(level * slots + ((expires_at >> (level * bits)) & (slots - 1)));
+        timers[slot].bucket = b;
+        buckets[b].push_front(timers, slot);
+    }
+
+    std::vector<Timer> timers;
+    std::vector<SlabList<Timer>> buckets;  // levels * slots once a timer was scheduled
+    std::size_t capacity = 0;
+    std::size_t scheduled = 0;
+    uint64_t current = 0;
+};
@@ -0,0 +1,200 @@
+#pragma once
+#include "frequency_sketch.hpp"
+#include "slab.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// W-TinyLFU (Einziger, Friedman, Manes).
+// New entries go to a small LRU window (1% of capacity). The window victim competes with the
+// main region victim and gets in only if the frequency sketch saw it more often.
+// The main region is a segmented LRU: probation entries move to the protected segment (80%
+// of the main region) on a hit, protected overflow is demoted back to probation.
+// The sketch counts lookups (get/find/access and put of a cached key), a put of a new key after
+// a missed get is counted once.
+template<class K = int, class V = int, class Hash = std::hash<K>>
+class TinyLFUCache {
+public:
+    static constexpr const char* name = "tinylfu";
+
+    TinyLFUCache() = default;
+    TinyLFUCache(std::size_t capacity) : sketch(capacity), index(capacity), capacity(capacity),
+        window_capacity(std::max<std::size_t>(capacity / 100, 1)),
+        protected_capacity((capacity - std::min(capacity, window_capacity)) * 4 / 5) {
+        check_slab_capacity(capacity);
+        nodes.reserve(capacity);
+    }
+
+    bool full() const;
+    std::size_t size() const { return window.size() + probation.size() + protected_.size(); }
+
+    // returns -1 (V{} for non-arithmetic values) on a miss, use find() to tell misses apart
+    V get(const K& key);
+    // returns pointer to the cached value or nullptr
+    V* find(const K& key);
+    void put(const K& key, const V& value);
+    // finds the key or caches make_value() for it with a single index probe,
+    // returns the cached value (nullptr if capacity is 0) and whether it was a hit
+    template<class F>
+    std::pair<V*, bool> access(const K& key, F&& make_value);
+
+private:
+    enum class Where : uint8_t {
+        window,
+        probation,
+        protected_
+    };
+
+    struct Node {
+        K key;
+        V value;
+        SlabLinks links;
+        Where where;
+    };
+
+    uint32_t lookup(std::size_t bucket, const K& key) const {
+        return index.find_in(bucket, key, [this](uint32_t slot) -> const K& { return nodes[slot].key; });
+    }
+
+    SlabList<Node>& list(Where where);
+    void move_to(uint32_t slot, Where where);
+    V* touch(uint32_t slot);
+    template<class F>
+    V* insert(std::size_t bucket, const K& key, F&& make_value);
+    uint32_t admit_window_victim();
+
+    std::vector<Node> nodes;
+    SlabList<Node> window, probation, protected_;
+    FrequencySketch<K, Hash> sketch;
+    SlabIndex<K, Hash> index;
+    std::size_t capacity = 0;
+    std::size_t window_capacity = 1;
+    std::size_t protected_capacity = 0;
+};
+
+template<class K, class V, class Hash>
+bool TinyLFUCache<K, V, Hash>::full() const {
+    return capacity == size();
+}
+
+template<class K, class V, class Hash>
+V TinyLFUCache<K, V, Hash>::get(const K& key) {
+    auto* value = find(key);
+    return value != nullptr ? *value : cache_miss_value<V>();
+}
+
+template<class K, class V, class Hash>
+V* TinyLFUCache<K, V, Hash>::find(const K& key) {
+    sketch.increment(key);
+    auto slot = lookup(index.bucket(key), key);
+    return slot != slab_npos ? touch(slot) : nullptr;
+}
+
+template<class K, class V, class Hash>
+void TinyLFUCache<K, V, Hash>::put(const K& key, const V& value) {
+    auto bucket = index.bucket(key);
+    auto slot = lookup(bucket, key);
+    if (slot != slab_npos) {
+        sketch.increment(key);
+        *touch(slot) = value;
+        return;
+    }
+    insert(bucket, key, [&value] { return value; });
+}
+
+template<class K, class V, class Hash>
+template<class F>
+std::pair<V*, bool> TinyLFUCache<K, V, Hash>::access(const K& key, F&& make_value) {
+    sketch.increment(key);
+    auto bucket = index.bucket(key);
+    auto slot = lookup(bucket, key);
+    if (slot != slab_npos) {
+        return {touch(slot), true};
+    }
+    return {insert(bucket, key, make_value), false};
+}
+
+template<class K, class V, class Hash>
+template<class F>
+V* TinyLFUCache<K, V, Hash>::insert(std::size_t bucket, const K& key, F&& make_value) {
+    if (capacity == 0) {
+        return nullptr;
+    }
+
+    auto slot = window.size() == window_capacity ? admit_window_victim() : slab_npos;
+    if (slot == slab_npos) {
+        slot = static_cast<uint32_t>(nodes.size());
+        nodes.push_back({key, make_value(), {}, Where::window});
+    } else {
+        nodes[slot].key = key;
+        nodes[slot].value = make_value();
+        nodes[slot].where = Where::window;
+    }
+    window.push_front(nodes, slot);
+    index.insert_in(bucket, slot);
+    return &nodes[slot].value;
+}
+
+template<class K, class V, class Hash>
+V* TinyLFUCache<K, V, Hash>::touch(uint32_t slot) {
+    switch (nodes[slot].where) {
+        case Where::window:
+            window.move_front(nodes, slot);
+            break;
+        case Where::probation:
+            move_to(slot, Where::protected_);
+            if (protected_.size() > protected_capacity) {
+                move_to(protected_.back(), Where::probation);
+            }
+            break;
+        case Where::protected_:
+            protected_.move_front(nodes, slot);
+            break;
+    }
+    return &nodes[slot].value;
+}
+
+// Moves the window LRU entry to the main region. When the cache is full it either replaces
+// the main region victim or is dropped itself, the freed slot is returned for reuse.
+template<class K, class V, class Hash>
+uint32_t TinyLFUCache<K, V, Hash>::admit_window_victim() {
+    auto candidate = window.back();
+    if (!full()) {
+        move_to(candidate, Where::probation);
+        return slab_npos;
+    }
+
+    auto freed = candidate;
+    if (!probation.empty() || !protected_.empty()) {
+        auto victim = !probation.empty() ? probation.back() : protected_.back();
+        if (sketch.estimate(nodes[candidate].key) > sketch.estimate(nodes[victim].key)) {
+            list(nodes[victim].where).unlink(nodes, victim);
+            move_to(candidate, Where::probation);
+            freed = victim;
+        }
+    }
+    if (freed == candidate) {
+        window.unlink(nodes, candidate);
+    }
+    index.erase(nodes[freed].key, freed);
+    return freed;
+}
+
+template<class K, class V, class Hash>
+SlabList<typename TinyLFUCache<K, V, Hash>::Node>& TinyLFUCache<K, V, Hash>::list(Where where) {
+    switch (where) {
+        case Where::window: return window;
+        case Where::probation: return probation;
+        default: return protected_;
+    }
+}
+
+template<class K, class V, class Hash>
+void TinyLFUCache<K, V, Hash>::move_to(uint32_t slot, Where where) {
+    list(nodes[slot].where).unlink(nodes, slot);
+    nodes[slot].where = where;
+    list(where).push_front(nodes, slot);
+}
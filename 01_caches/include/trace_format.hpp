@@ -0,0 +1,130 @@
+#pragma once
+#include "mapped_file.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Binary request trace: a header with the cache capacity and the number of requests (the "m n" of the
+// text format), then every key as a LEB128 varint of the zigzag-encoded difference from the previous key
+// (the first one from 0), modulo 2^32. Sequential keys take a byte, keys out of a universe of U dense ids
+// (e.g. trace_gen's ranks) at most ceil((log2(U) + 1) / 7), three for a million ids; any key at most five,
+// which is what hashed or scattered keys take.
+// The reader maps the file and decodes the keys in one pass straight from the page cache.
+
+struct TraceHeader {
+    uint64_t magic = 0x3130454341525443ull;  // "CTRACE01"
+    uint32_t version = 1;
+    uint32_t key_size = sizeof(int32_t);
+    uint64_t capacity = 0;
+    uint64_t count = 0;
+};
+
+class TraceWriter {
+public:
+    TraceWriter(const std::string& path, uint64_t capacity) : out(path, std::ios::binary | std::ios::trunc) {
+        if (!out) {
+            throw std::runtime_error("Can't open trace file " + path);
+        }
+        header.capacity = capacity;
+        // the count is written by finish()
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        buffer.resize(buffer_size);
+    }
+
+    void write(int key) {
+        if (used + max_varint > buffer.size()) {
+            flush();
+        }
+        auto delta = static_cast<uint32_t>(key) - previous;
+        previous = static_cast<uint32_t>(key);
+        auto zigzag = (delta << 1) ^ (0u - (delta >> 31));
+        while (zigzag >= 0x80) {
+            buffer[used++] = static_cast<char>(zigzag | 0x80);
+            zigzag >>= 7;
+        }
+        buffer[used++] = static_cast<char>(zigzag);
+        ++header.count;
+    }
+
+    // throws if anything failed to be written
+    void finish() {
+        flush();
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.flush();
+        if (!out) {
+            throw std::runtime_error("Failed to write trace");
+        }
+    }
+
+private:
+    static constexpr std::size_t buffer_size = 1 << 20;
+    static constexpr std::size_t max_varint = 5;
+
+    void flush() {
+        out.write(buffer.data(), static_cast<std::streamsize>(used));
+        used = 0;
+    }
+
+    std::ofstream out;
+    TraceHeader header;
+    std::vector<char> buffer;
+    std::size_t used = 0;
+    uint32_t previous = 0;
+};
+
+class TraceReader {
+public:
+    explicit TraceReader(const std::string& path) : file(path) {
+        if (file.size() < sizeof(TraceHeader)) {
+            throw std::runtime_error("Trace file " + path + " is truncated");
+        }
+        std::memcpy(&header, file.data(), sizeof(header));
+        TraceHeader expected;
+        if (header.magic != expected.magic || header.version != expected.version ||
+            header.key_size != expected.key_size) {
+            throw std::runtime_error("File " + path + " isn't a binary trace");
+        }
+    }
+
+    uint64_t capacity() const { return header.capacity; }
+    std::size_t size() const { return header.count; }
+
+    // calls f(key) for every request in order, throws if the file ends before the last one
+    template<class F>
+    void for_each(F&& f) const {
+        auto* p = reinterpret_cast<const unsigned char*>(file.data()) + sizeof(header);
+        auto* end = reinterpret_cast<const unsigned char*>(file.data()) + file.size();
+        uint32_t key = 0;
+        for (uint64_t i = 0; i < header.count; ++i) {
+            uint32_t zigzag = 0;
+            for (unsigned shift = 0;; shift += 7) {
+                if (p == end || shift > 28) {
+                    throw std::runtime_error("Trace file is corrupted");
+                }
+                auto byte = *p++;
+                zigzag |= static_cast<uint32_t>(byte & 0x7f) << shift;
+                if (byte < 0x80) {
+                    break;
+                }
+            }
+            key += (zigzag >> 1) ^ (0u - (zigzag & 1));
+            f(static_cast<int>(key));
+        }
+    }
+
+    std::vector<int> keys() const {
+        std::vector<int> keys;
+        keys.reserve(size());
+        for_each([&keys](int k) { keys.push_back(k); });
+        return keys;
+    }
+
+private:
+    MappedFile file;
+    TraceHeader header;
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Synthetic request traces for benchmarks and simulations over a universe of `keys` keys.
+// Generators produce ranks (0 is the most popular key), scatter_key() spreads them over the int range
+// with a bijection, so distinct ranks stay distinct keys and popular keys don't share index buckets.
+
+inline int scatter_key(uint64_t rank) {
+    return static_cast<int>(static_cast<uint32_t>(rank) * 0x9E3779B1u);
+}
+
+// Zipf(alpha) ranks in [0, n) by rejection-inversion (Hormann, Derflinger), O(1) time and memory per
+// sample whatever n is, so 100M-key universes don't need a table of weights.
+class ZipfGenerator {
+public:
+    ZipfGenerator(uint64_t n, double alpha) : n(static_cast<double>(n)), alpha(alpha) {
+        if (n == 0 || alpha <= 0) {
+            throw std::invalid_argument("Zipf distribution needs keys and a positive exponent");
+        }
+        h_integral_x1 = h_integral(1.5) - 1.0;
+        h_integral_n = h_integral(this->n + 0.5);
+        threshold = 2.0 - h_integral_inverse(h_integral(2.5) - h(2.0));
+    }
+
+    template<class Generator>
+    uint64_t operator()(Generator& gen) const {
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        while (true) {
+            auto u = h_integral_n + uniform(gen) * (h_integral_x1 - h_integral_n);
+            auto x = h_integral_inverse(u);
+            auto k = std::min(std::max(std::floor(x + 0.5), 1.0), n);
+            if (k - x <= threshold || u >= h_integral(k + 0.5) - h(k)) {
+                return static_cast<uint64_t>(k) - 1;
+            }
+        }
+    }
+
+private:
+    double h(double x) const { return std::exp(-alpha * std::log(x)); }
+
+    double h_integral(double x) const {
+        auto log_x = std::log(x);
+        return expm1_over_x((1.0 - alpha) * log_x) * log_x;
+    }
+
+    double h_integral_inverse(double x) const {
+        auto t = std::max(x * (1.0 - alpha), -1.0);
+        return std::exp(log1p_over_x(t) * x);
+    }
+
+    // log(1 + x) / x and (e^x - 1) / x, stable around 0 (alpha close to 1)
+    static double log1p_over_x(double x) {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+    static double expm1_over_x(double x) {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+    }
+
+    double n;
+    double alpha;
+    double h_integral_x1;
+    double h_integral_n;
+    double threshold;
+};
+
+enum class Workload {
+    zipf,   // Zipf(alpha) over all keys
+    scan,   // all keys in order, again and again: nothing is reused within a cache lifetime
+    loop,   // a cycle over 1.25 * capacity keys: LRU never hits, frequency-aware policies keep a part
+    mixed,  // 3/4 Zipf(alpha) requests, 1/4 a sequential scan of keys never seen again
+    phases  // Zipf(alpha) whose ranking rotates by a quarter of the keys every phase: the hot set moves
+};
+
+inline std::string workload_name(Workload workload) {
+    switch (workload) {
+        case Workload::zipf: return "zipf";
+        case Workload::scan: return "scan";
+        case Workload::loop: return "loop";
+        case Workload::mixed: return "mixed";
+        default: return "phases";
+    }
+}
+
+inline Workload parse_workload(const std::string& name) {
+    for (auto workload : {Workload::zipf, Workload::scan, Workload::loop, Workload::mixed, Workload::phases}) {
+        if (workload_name(workload) == name) {
+            return workload;
+        }
+    }
+    throw std::invalid_argument("Unknown workload " + name);
+}
+
+// Streams the keys of a workload one by one in O(1) memory, so traces of any length can be written out
+// without being held in memory.
+class TraceGenerator {
+public:
+    TraceGenerator(Workload workload, uint64_t keys, std::size_t capacity, double alpha = 0.99, unsigned seed = 42,
+        uint64_t phase_length = 1 << 22)
+        : workload(workload), keys(keys), cycle(std::max<uint64_t>(capacity + capacity / 4, 1)),
+          phase_length(std::max<uint64_t>(phase_length, 1)), gen(seed), zipf(keys, alpha), scanned(keys) {}
+
+    // the next key, scattered
+    int operator()() { return scatter_key(rank()); }
+
+    // the next key's rank instead, a dense id that trace files store compactly (see trace_format.hpp)
+    uint64_t rank() {
+        auto i = position++;
+        switch (workload) {
+            case Workload::zipf: return zipf(gen);
+            case Workload::scan: return i % keys;
+            case Workload::loop: return i % cycle;
+            case Workload::mixed: return gen() % 4 != 0 ? zipf(gen) : scanned++;
+            default: {
+                auto shift = (i / phase_length % keys) * (keys / 4 + 1) % keys;
+                return (zipf(gen) + shift) % keys;
+            }
+        }
+    }
+
+private:
+    Workload workload;
+    uint64_t keys;
+    uint64_t cycle;
+    uint64_t phase_length;
+    std::mt19937_64 gen;
+    ZipfGenerator zipf;
+    uint64_t scanned;  // next fresh rank of the mixed scan
+    uint64_t position = 0;
+};
+
+// the phases workload shifts four times over the trace
+inline std::vector<int> make_trace(Workload workload, uint64_t keys, std::size_t capacity, std::size_t length,
+    double alpha = 0.99, unsigned seed = 42) {
+    TraceGenerator next(workload, keys, capacity, alpha, seed, length / 4);
+    std::vector<int> trace(length);
+    for (auto& k : trace) {
+        k = next();
+    }
+    return trace;
+}
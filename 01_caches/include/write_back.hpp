@@ -0,0 +1,254 @@
+#pragma once
+#include "cache.hpp"
+#include "lru.hpp"
+
+#include <chrono>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Write-back cache in front of a Store (e.g. FileStore) with
+//   std::optional<V> load(const K&)                     - thread-safe against a running store()
+//   void store(const std::vector<std::pair<K, V>>&)     - writes a batch
+// put() only marks the cached entry dirty. A dirty entry leaving the cache (see Cache::set_removal_listener)
+// joins the pending victims, coalesced by key; a background thread hands them to the store in batches
+// of batch_size, or whatever is pending every flush_interval, so an eviction never waits for a write.
+// A miss reads through: the pending and in-flight victims first, then the store.
+// flush() writes every dirty entry and waits for it, the destructor flushes too. A caller guarding the
+// cache with its own lock can hold it for start_flush() only and wait_flushed() without it.
+//
+// The foreground is single-threaded like the underlying Cache, only the flusher runs in parallel.
+// A failed store() is retried after flush_interval and rethrown by flush(): by every flush() waiting at
+// the time, or by the next one; the destructor can't report it.
+template<class K, class V, class Store, class EvictionPolicy = LRUPolicy, class Hash = std::hash<K>>
+class WriteBackCache {
+public:
+    WriteBackCache(std::size_t capacity, Store& store, std::size_t batch_size = 256,
+        std::chrono::milliseconds flush_interval = std::chrono::milliseconds(100));
+    WriteBackCache(const WriteBackCache&) = delete;
+    WriteBackCache& operator=(const WriteBackCache&) = delete;
+    ~WriteBackCache();
+
+    std::optional<V> get(const K& key);
+    // get() without the store: the cached value or a victim not written yet
+    std::optional<V> find(const K& key);
+    void put(const K& key, const V& value);
+    // caches a value the store already has, it isn't written again
+    void promote(const K& key, const V& value) { cache.put(key, {value, false}); }
+    void flush() { wait_flushed(start_flush()); }
+    // queues the dirty entries, returns what wait_flushed() waits for
+    uint64_t start_flush();
+    // waits until what start_flush() queued was written (or a batch failed), doesn't touch the cache:
+    // can run concurrently with the foreground
+    void wait_flushed(uint64_t target);
+
+    std::size_t size() const { return cache.size(); }
+    // store() calls made by the flusher
+    uint64_t batches() const;
+
+private:
+    struct Slot {
+        V value;
+        bool dirty;
+    };
+
+    void flusher_loop();
+
+    Cache<K, Slot, EvictionPolicy, SlabIndex<K, Hash>> cache;
+    Store& store;
+    std::size_t batch_size;
+    std::chrono::milliseconds flush_interval;
+
+    mutable std::mutex mutex;  // everything below
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::unordered_map<K, V, Hash> pending;
+    std::unordered_map<K, V, Hash> writing;  // the batch being stored
+    std::size_t flush_waiters = 0;
+    bool stopping = false;
+    uint64_t batches_count = 0;
+    uint64_t taken = 0;   // batches taken from pending, numbered from 1
+    uint64_t stored = 0;  // the last one written
+    uint64_t failures = 0;
+    std::exception_ptr error;         // the last failure, until a flush() reports it
+    std::exception_ptr last_failure;
+    std::thread flusher;
+};
+
+template<class K, class V, class Store, class EvictionPolicy, class Hash>
+WriteBackCache<K, V, Store, EvictionPolicy, Hash>::WriteBackCache(std::size_t capacity, Store& store,
+    std::size_t batch_size, std::chrono::milliseconds flush_interval)
+    : cache(capacity), store(store), batch_size(std::max<std::size_t>(batch_size, 1)),
+      flush_interval(flush_interval) {
+    if (capacity == 0) {
+        // a put() the cache doesn't keep would never be written
+        throw std::invalid_argument("Write-back cache needs a capacity");
+    }
+    cache.set_removal_listener([this](const K& key, Slot& slot) {
+        if (!slot.dirty) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        pending[key] = slot.value;
+        if (pending.size() >= this->batch_size) {
+            wake.notify_one();
+        }
+    });
+    flusher = std::thread([this] { flusher_loop(); });
+}
+
+template<class K, class V, class Store, class EvictionPolicy, class Hash>
+WriteBackCache<K, V, Store, EvictionPolicy, Hash>::~WriteBackCache() {
+    try {
+        flush();
+    } catch (...) {
+        // the last batch keeps failing: nowhere to report it
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    flusher.join();
+}
+
+template<class K, class V, class Store, class EvictionPolicy, class Hash>
+std::optional<V> WriteBackCache<K, V, Store, EvictionPolicy, Hash>::get(const K& key) {
+    if (auto value = find(key)) {
+        return value;
+    }
+    auto value = store.load(key);
+    if (value) {
+        promote(key, *value);
+    }
+    return value;
+}
+
+template<class K, class V, class Store, class EvictionPolicy, class Hash>
+std::optional<V> WriteBackCache<K, V, Store, EvictionPolicy, Hash>::find(const K& key) {
+    if (auto* slot = cache.find(key)) {
+        return slot->value;
+    }
+    std::optional<V> value;
+    bool dirty = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (auto it = pending.find(key); it != pending.end()) {
+            value = it->second;
+            // handed back to the cache, it's written when it leaves it again
+            pending.erase(it);
+            dirty = true;
+        } else if (auto it = writing.find(key); it != writing.end()) {
+            value = it->second;
+        }
+    }
+    if (value) {
+        cache.put(key, {*value, dirty});
+    }
+    return value;
+}
+
+template<class K, class V, class Store, class EvictionPolicy, class Hash>
+void WriteBackCache<K, V, Store, EvictionPolicy, Hash>::put(const K& key, const V& value) {
+    cache.put(key, {value, true});
+}
+
+template<class K, class V, class Store, class EvictionPolicy, class Hash>
+uint64_t WriteBackCache<K, V, Store, EvictionPolicy, Hash>::start_flush() {
+    // collected before locking: for_each() may expire entries, which calls the removal listener
+    std::vector<std::pair<K, V>> dirty;
+    cache.for_each([&dirty](const K& key, Slot& slot) {
+        if (slot.dirty) {
+            dirty.emplace_back(key, slot.value);
+            slot.dirty = false;
+        }
+    });
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& [key, value] : dirty) {
+        pending[key] = std::move(value);
+    }
+    // the next batch takes all of pending, or the one being written is the last
+    return pending.empty() ? taken : taken + 1;
+}
+
+template<class K, class V, class Store, class EvictionPolicy, class Hash>
+void WriteBackCache<K, V, Store, EvictionPolicy, Hash>::wait_flushed(uint64_t target) {
+    std::unique_lock<std::mutex> lock(mutex);
+    ++flush_waiters;
+    wake.notify_one();
+    auto failures_before = failures;
+    // evictions meanwhile don't hold it up: only the batch with what was queued is waited for
+    done.wait(lock, [this, target, failures_before] {
+        return stored >= target || (pending.empty() && writing.empty()) || failures != failures_before || error;
+    });
+    --flush_waiters;
+    if (failures != failures_before) {
+        // a batch failed while waiting: every waiter reports it
+        error = nullptr;
+        std::rethrow_exception(last_failure);
+    }
+    if (error) {
+        std::rethrow_exception(std::exchange(error, nullptr));
+    }
+}
+
+template<class K, class V, class Store, class EvictionPolicy, class Hash>
+uint64_t WriteBackCache<K, V, Store, EvictionPolicy, Hash>::batches() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return batches_count;
+}
+
+template<class K, class V, class Store, class EvictionPolicy, class Hash>
+void WriteBackCache<K, V, Store, EvictionPolicy, Hash>::flusher_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait_for(lock, flush_interval,
+            [this] { return stopping || pending.size() >= batch_size || (flush_waiters > 0 && !pending.empty()); });
+        if (pending.empty()) {
+            if (stopping) {
+                return;
+            }
+            continue;
+        }
+        writing.swap(pending);
+        auto number = ++taken;
+        std::vector<std::pair<K, V>> batch(writing.begin(), writing.end());
+        lock.unlock();
+        std::exception_ptr failure;
+        try {
+            store.store(batch);
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        lock.lock();
+        if (failure) {
+            // back to pending for the next batch, unless a newer value got there meanwhile
+            for (auto& [key, value] : writing) {
+                pending.try_emplace(key, value);
+            }
+            error = last_failure = failure;
+            ++failures;
+            writing.clear();
+            done.notify_all();
+            if (stopping) {
+                return;
+            }
+            // back off instead of retrying right away, the waiters and a full batch would wake it
+            wake.wait_for(lock, flush_interval, [this] { return stopping; });
+            continue;
+        }
+        ++batches_count;
+        stored = number;
+        writing.clear();
+        done.notify_all();
+    }
+}
@@ -1,29 +1,113 @@
-#include <lru.hpp>
-#include <lfu.hpp>
+#include <replay.hpp>
+#include <trace_format.hpp>
+
+#include <algorithm>
+#include <cctype>
 #include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reads "m n k1 ... kn" from stdin once, or maps a binary trace (see trace_format.hpp) given as an argument,
+// and replays it through every policy and capacity on a pool of threads (see replay.hpp).
+// The binary trace isn't decoded into memory: every replay decodes it from the mapping.
+// The capacities default to the one of the trace. A single capacity prints "LRU: hits" lines,
+// several print the hits matrix as "capacity,policy1,policy2,..." CSV.
+// --dense remaps the keys to 0..U-1 first and replays in the simulation mode: LRU, LFU and perfect
+// caches index flat arrays by the key instead of hash maps (see dense_index.hpp).
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::istringstream in(list);
+    for (std::string item; std::getline(in, item, ',');) {
+        items.push_back(item);
+    }
+    return items;
+}
 
 int main(int argc, char* argv[]) {
-    int m, n, k;
-    int lru_hits = 0, lfu_hits = 0;
-    std::cin >> m >> n;
-    LRUCache lru_cache(m);
-    LFUCache lfu_cache(m);
-    for (int i = 0; i < n; ++i) {
-        std::cin >> k;
-        if (lru_cache.get(k) != -1) {
-            ++lru_hits;
+    std::vector<std::string> policies = {"lru", "lfu", "arc"};
+    std::vector<std::size_t> capacities;
+    unsigned threads = std::thread::hardware_concurrency();
+    std::string path;
+    bool dense = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--policies" && i + 1 < argc) {
+            policies = split(argv[++i]);
+        } else if (arg == "--capacities" && i + 1 < argc) {
+            for (auto& capacity : split(argv[++i])) {
+                capacities.push_back(std::stoul(capacity));
+            }
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--dense") {
+            dense = true;
+        } else if (arg[0] != '-' && path.empty()) {
+            path = arg;
         } else {
-            lru_cache.put(k, k);
+            std::cerr << "Usage: " << argv[0] << " [--policies lru,lfu,arc] [--capacities c1,c2,...] [--threads N]"
+                      << " [--dense] [trace.bin] < trace\n";
+            return 1;
         }
+    }
 
-        if (lfu_cache.get(k) != -1) {
-            ++lfu_hits;
-        } else {
-            lfu_cache.put(k, k);
+    std::size_t m;
+    std::optional<TraceReader> reader;
+    std::vector<int> trace;
+    if (!path.empty()) {
+        reader.emplace(path);
+        m = reader->capacity();
+    } else {
+        std::size_t n;
+        std::cin >> m >> n;
+        trace.resize(n);
+        for (auto& k : trace) {
+            std::cin >> k;
+        }
+    }
+    if (capacities.empty()) {
+        capacities.push_back(m);
+    }
+
+    std::vector<ReplayConfig> configs;
+    for (auto capacity : capacities) {
+        for (auto& policy : policies) {
+            configs.push_back({policy, capacity});
         }
     }
+    std::vector<std::size_t> hits;
+    if (dense) {
+        auto dense_trace = reader ? remap_dense<int>(reader->size(), [&reader](auto&& f) { reader->for_each(f); })
+            : remap_dense(trace);
+        trace = {};
+        hits = replay_parallel(dense_trace, configs, threads);
+    } else if (reader) {
+        hits = replay_parallel(*reader, configs, threads);
+    } else {
+        hits = replay_parallel(trace, configs, threads);
+    }
 
-    std::cout << "LRU: " << lru_hits << "\n";
-    std::cout << "LFU: " << lfu_hits << "\n";
+    if (capacities.size() == 1) {
+        for (std::size_t p = 0; p < policies.size(); ++p) {
+            auto name = policies[p];
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::toupper(c); });
+            std::cout << name << ": " << hits[p] << "\n";
+        }
+        return 0;
+    }
+    std::cout << "capacity";
+    for (auto& policy : policies) {
+        std::cout << "," << policy;
+    }
+    std::cout << "\n";
+    for (std::size_t c = 0; c < capacities.size(); ++c) {
+        std::cout << capacities[c];
+        for (std::size_t p = 0; p < policies.size(); ++p) {
+            std::cout << "," << hits[c * policies.size() + p];
+        }
+        std::cout << "\n";
+    }
     return 0;
 }
@@ -3,6 +3,7 @@
 from pathlib import Path
 from argparse import ArgumentParser
 from random import randrange, randint
+from collections import OrderedDict
 import shutil
 
 
@@ -70,6 +71,129 @@ def lfu(data: list) -> int:
     return hits
 
 
+def arc(data: list) -> int:
+    cache_size = data[0]
+    # OrderedDicts ordered from LRU to MRU
+    t1, t2, b1, b2 = OrderedDict(), OrderedDict(), OrderedDict(), OrderedDict()
+    p = 0
+    hits = 0
+
+    def replace(in_b2: bool):
+        if t1 and (not t2 or (in_b2 and len(t1) == p) or len(t1) > p):
+            b1[t1.popitem(last=False)[0]] = None
+        else:
+            b2[t2.popitem(last=False)[0]] = None
+
+    for i in data[2:]:
+        if i in t1:
+            hits += 1
+            del t1[i]
+            t2[i] = None
+        elif i in t2:
+            hits += 1
+            t2.move_to_end(i)
+        elif i in b1:
+            p = min(cache_size, p + max(len(b2) // len(b1), 1))
+            replace(False)
+            del b1[i]
+            t2[i] = None
+        elif i in b2:
+            p = max(0, p - max(len(b1) // len(b2), 1))
+            replace(True)
+            del b2[i]
+            t2[i] = None
+        else:
+            if len(t1) + len(b1) == cache_size:
+                if len(t1) < cache_size:
+                    b1.popitem(last=False)
+                    replace(False)
+                else:
+                    t1.popitem(last=False)
+            else:
+                total = len(t1) + len(t2) + len(b1) + len(b2)
+                if total >= cache_size:
+                    if total == 2 * cache_size:
+                        b2.popitem(last=False)
+                    replace(False)
+            t1[i] = None
+    return hits
+
+
+class FrequencySketch:
+    """Mirror of FrequencySketch from frequency_sketch.hpp, counters are kept unpacked."""
+    MASK = (1 << 64) - 1
+    SEEDS = [0xc3a5c85c97cb3127, 0xb492b66fbe98f273, 0x9ae16a3b2f90404f, 0xcbf29ce484222325]
+
+    def __init__(self, capacity: int):
+        self.width = 16
+        while self.width < 4 * capacity:
+            self.width *= 2
+        self.table = [[0] * self.width for _ in self.SEEDS]
+        self.additions = 0
+        self.sample_size = 10 * max(capacity, 1)
+
+    def counter(self, key: int, row: int) -> int:
+        x = ((key & self.MASK) + self.SEEDS[row]) & self.MASK
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9 & self.MASK
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EB & self.MASK
+        x ^= x >> 31
+        return x & (self.width - 1)
+
+    def increment(self, key: int):
+        added = False
+        for row, counters in enumerate(self.table):
+            i = self.counter(key, row)
+            if counters[i] < 15:
+                counters[i] += 1
+                added = True
+        if added:
+            self.additions += 1
+            if self.additions == self.sample_size:
+                self.table = [[c >> 1 for c in counters] for counters in self.table]
+                self.additions //= 2
+
+    def estimate(self, key: int) -> int:
+        return min(counters[self.counter(key, row)] for row, counters in enumerate(self.table))
+
+
+def tinylfu(data: list) -> int:
+    cache_size = data[0]
+    window_size = max(cache_size // 100, 1)
+    protected_size = (cache_size - min(cache_size, window_size)) * 4 // 5
+    # OrderedDicts ordered from LRU to MRU
+    window, probation, protected = OrderedDict(), OrderedDict(), OrderedDict()
+    sketch = FrequencySketch(cache_size)
+    hits = 0
+    for i in data[2:]:
+        sketch.increment(i)
+        if i in window:
+            hits += 1
+            window.move_to_end(i)
+        elif i in probation:
+            hits += 1
+            del probation[i]
+            protected[i] = None
+            if len(protected) > protected_size:
+                probation[protected.popitem(last=False)[0]] = None
+        elif i in protected:
+            hits += 1
+            protected.move_to_end(i)
+        else:
+            if len(window) == window_size:
+                full = len(window) + len(probation) + len(protected) == cache_size
+                candidate = window.popitem(last=False)[0]
+                if not full:
+                    probation[candidate] = None
+                elif probation or protected:
+                    main = probation if probation else protected
+                    victim = next(iter(main))
+                    if sketch.estimate(candidate) > sketch.estimate(victim):
+                        del main[victim]
+                        probation[candidate] = None
+            window[i] = None
+    return hits
+
+
 def perfect(data: list) -> int:
     cache_size = data[0]
     cache = []
@@ -118,8 +242,12 @@ def main():
         algos = [lfu]
     elif args.algo == 'perfect':
         algos = [perfect]
+    elif args.algo == 'arc':
+        algos = [arc]
+    elif args.algo == 'tinylfu':
+        algos = [tinylfu]
     elif args.algo == 'all':
-        algos = [lru, perfect, lfu]
+        algos = [lru, perfect, lfu, arc, tinylfu]
     else:
         raise ValueError(f"Unknown alorithm was provided {args.algo}")
 
@@ -1,18 +1,56 @@
+#include "arc.hpp"
+#include "cache.hpp"
+#include "clock.hpp"
+#include "clock_pro.hpp"
+#include "concurrent_lfu.hpp"
+#include "file_store.hpp"
+#include "flat_index.hpp"
+#include "front_cache.hpp"
+#include "loading_cache.hpp"
 #include "lru.hpp"
+#include "mrc.hpp"
+#include "sharded_lru.hpp"
 #include "lfu.hpp"
 #include "perfect_cache.hpp"
+#include "replay.hpp"
+#include "shards.hpp"
+#include "tiered_cache.hpp"
+#include "timing_wheel.hpp"
+#include "tinylfu.hpp"
+#include "trace_format.hpp"
+#include "workloads.hpp"
+#include "write_back.hpp"
 
 #include <utils/test_utils.hpp>
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <future>
+#include <cmath>
+#include <condition_variable>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
 #include <filesystem>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <utility>
 
 namespace fs = std::filesystem;
 
+using FlatLRUCache = LRUCache<int, int, std::hash<int>, FlatIndex<int>>;
+using FlatLFUCache = LFUCache<int, int, std::hash<int>, FlatIndex<int>>;
+using FlatPerfectCache = PerfectCache<int, int, std::hash<int>, FlatIndex<int>>;
+
 template<class Cache>
 class CacheFixtureTests : public testing::Test {
 public:
@@ -35,15 +73,7 @@ public:
     }
 protected:
     std::string get_name() const {
-        if constexpr (std::is_same<Cache, LRUCache>::value) {
-            return "lru";
-        }
-        else if constexpr (std::is_same<Cache, LFUCache>::value) {
-            return "lfu";
-        }
-        else if constexpr (std::is_same<Cache, PerfectCache>::value) {
-            return "perfect";
-        }
+        return Cache::name;
     }
 
     // std::string get_name() const {
@@ -79,8 +109,16 @@ protected:
         return answer;
     }
 
+    Cache make_cache(int capacity, const std::vector<int>& input) {
+        if constexpr (std::is_constructible<Cache, int, const std::vector<int>&>::value) {
+            return Cache(capacity, input);
+        } else {
+            return Cache(capacity);
+        }
+    }
+
     int calc_hits_number(int capacity, const std::vector<int>& input) {
-        Cache cache(capacity);
+        auto cache = make_cache(capacity, input);
         int hits = 0;
         for (auto k : input) {
             if (cache.get(k) != -1) {
@@ -91,21 +129,18 @@ protected:
         }
         return hits;
     }
-};
 
-template<>
-int CacheFixtureTests<PerfectCache>::calc_hits_number(int capacity, const std::vector<int>& input) {
-    PerfectCache cache(capacity, input);
-    int hits = 0;
-    for (auto k : input) {
-        if (cache.get(k) != -1) {
-            ++hits;
-        } else {
-            cache.put(k, k);
+    int calc_access_hits_number(int capacity, const std::vector<int>& input) {
+        auto cache = make_cache(capacity, input);
+        int hits = 0;
+        for (auto k : input) {
+            if (cache.access(k, [k] { return k; }).second) {
+                ++hits;
+            }
         }
+        return hits;
     }
-    return hits;
-}
+};
 
 // alternative to constexpr
 // template<>
@@ -131,11 +166,1274 @@ TYPED_TEST_P(CacheFixtureTests, End2EndTest) {
     }
 }
 
-REGISTER_TYPED_TEST_SUITE_P(CacheFixtureTests, End2EndTest);
+TYPED_TEST_P(CacheFixtureTests, AccessEnd2EndTest) {
+    for (auto file_str : get_files_in_dir(this->data_directory())) {
+        auto input_file = fs::path(file_str);
+        auto answer_file = input_file.parent_path() / "answers"/ this->get_name() / input_file.filename();
+        auto [capacity, input] = this->read_input_data(input_file);
+        ASSERT_EQ(this->read_answer_data(answer_file), this->calc_access_hits_number(capacity, input))
+            << "on input data: " << input_file << '\n'
+            << "answer file: " << answer_file << '\n';
+    }
+}
+
+REGISTER_TYPED_TEST_SUITE_P(CacheFixtureTests, End2EndTest, AccessEnd2EndTest);
 
-using Types = testing::Types<LFUCache, LRUCache, PerfectCache>;
+using Types = testing::Types<LFUCache<>, LRUCache<>, PerfectCache<>, ARCCache<>, TinyLFUCache<>,
+    FlatLRUCache, FlatLFUCache, FlatPerfectCache>;
 INSTANTIATE_TYPED_TEST_SUITE_P(Caches, CacheFixtureTests, Types);
 
+// A policy plugged into Cache from outside: FIFO ignores hits.
+struct FIFOPolicy {
+    static constexpr const char* name = "fifo";
+
+    struct Hook {};
+
+    template<class Entry>
+    class Order : public OrderDefaults {
+    public:
+        Order() = default;
+        Order(FIFOPolicy, std::size_t) {}
+
+        void touch(std::vector<Entry>&, uint32_t) {}
+        void insert(std::vector<Entry>& entries, uint32_t slot) { queue.push_front(entries, slot); }
+        uint32_t victim(const std::vector<Entry>& entries, uint32_t keep) const {
+            auto slot = queue.back();
+            return slot != keep ? slot : entries[slot].links.prev;
+        }
+        void erase(std::vector<Entry>& entries, uint32_t slot, bool) { queue.unlink(entries, slot); }
+
+    private:
+        SlabList<Entry> queue;
+    };
+};
+
+TEST(CacheTests, CustomPolicy) {
+    Cache<int, int, FIFOPolicy> cache(3, 9);
+    ASSERT_EQ(std::string(decltype(cache)::name), "fifo");
+    for (int k = 1; k <= 3; ++k) {
+        cache.put(k, k);
+    }
+    ASSERT_TRUE(cache.access(1, [] { return 1; }).second);
+    cache.put(4, 4);
+    // the hit didn't save the oldest entry
+    ASSERT_EQ(cache.find(1), nullptr);
+    cache.put(3, 3, 8);
+    ASSERT_EQ(cache.find(2), nullptr);
+    ASSERT_EQ(cache.get(3), 3);
+    ASSERT_EQ(cache.get(4), 4);
+    ASSERT_EQ(cache.weight(), 9u);
+}
+
+TEST(LRUCacheTests, GenericKeysAndValues) {
+    LRUCache<std::string, std::string> cache(2);
+    cache.put("a", "1");
+    cache.put("b", "2");
+    ASSERT_EQ(cache.get("a"), "1");
+    cache.put("c", "3");  // "b" is the least recently used one
+    ASSERT_EQ(cache.find("b"), nullptr);
+    ASSERT_NE(cache.find("a"), nullptr);
+    ASSERT_EQ(*cache.find("c"), "3");
+    cache.put("c", "4");
+    ASSERT_EQ(cache.get("c"), "4");
+    ASSERT_EQ(cache.size(), 2u);
+}
+
+TEST(LRUCacheTests, ZeroCapacity) {
+    LRUCache<> cache(0);
+    cache.put(1, 1);
+    ASSERT_EQ(cache.get(1), -1);
+}
+
+TEST(LRUCacheTests, WeightedEviction) {
+    LRUCache<> cache(10, 100);
+    cache.put(1, 1, 60);
+    cache.put(2, 2, 30);
+    cache.put(3, 3, 20);
+    ASSERT_EQ(cache.find(1), nullptr);
+    ASSERT_EQ(cache.weight(), 50u);
+    // heavier than the whole budget
+    cache.put(4, 4, 101);
+    ASSERT_EQ(cache.find(4), nullptr);
+    ASSERT_EQ(cache.size(), 2u);
+    // growing entry 2 pushes out the least recent entry 3
+    cache.put(2, 2, 90);
+    ASSERT_EQ(cache.find(3), nullptr);
+    ASSERT_EQ(cache.weight(), 90u);
+
+    cache.access(5, [] { return 5; }, 10);
+    cache.access(2, [] { return 2; }, 90);
+    ASSERT_EQ(cache.stats().hits, 1u);
+    ASSERT_EQ(cache.stats().misses, 1u);
+    ASSERT_DOUBLE_EQ(cache.stats().hit_ratio(), 0.5);
+    ASSERT_DOUBLE_EQ(cache.stats().byte_hit_ratio(), 0.9);
+}
+
+TEST(LRUCacheTests, ExpiresEntries) {
+    uint64_t now = 1000;
+    LRUCache<> cache(10);
+    cache.set_clock([&now] { return now; });
+    cache.put(1, 1, 1, 100);
+    cache.put(2, 2, 1, 50);
+    cache.put(3, 3);
+    now = 1049;
+    ASSERT_NE(cache.find(2), nullptr);
+    now = 1050;
+    ASSERT_EQ(cache.find(2), nullptr);
+    ASSERT_EQ(cache.size(), 2u);
+    // put refreshes the ttl
+    cache.put(1, 1, 1, 1000);
+    now = 1500;
+    ASSERT_NE(cache.find(1), nullptr);
+    now = 1000000;
+    ASSERT_EQ(cache.find(1), nullptr);
+    ASSERT_NE(cache.find(3), nullptr);
+    ASSERT_EQ(cache.size(), 1u);
+}
+
+// A restored cache has to behave exactly as the saved one: every access of the rest of the trace
+// hits or misses in both.
+template<class Cache>
+void expect_same_hits(Cache& saved, Cache& restored, const std::vector<int>& trace) {
+    ASSERT_EQ(restored.size(), saved.size());
+    for (auto k : trace) {
+        ASSERT_EQ(restored.access(k, [k] { return k; }).second, saved.access(k, [k] { return k; }).second);
+    }
+}
+
+std::vector<int> random_trace(int n, int keys, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::geometric_distribution<int> dist(1.0 / keys);
+    std::vector<int> trace(n);
+    for (auto& k : trace) {
+        k = dist(gen);
+    }
+    return trace;
+}
+
+TEST(LRUCacheTests, SnapshotRoundTrip) {
+    auto path = (fs::temp_directory_path() / "caches_lru_snapshot.bin").string();
+    auto trace = random_trace(10000, 300, 1);
+    LRUCache<> cache(100);
+    for (auto k : trace) {
+        cache.access(k, [k] { return k; });
+    }
+    cache.save_snapshot(path);
+
+    // a smaller cache keeps the most recent entries
+    LRUCache<> small(10);
+    small.load_snapshot(path);
+    ASSERT_EQ(small.size(), 10u);
+    std::vector<int> recent;
+    for (auto it = trace.rbegin(); recent.size() < 10; ++it) {
+        if (std::find(recent.begin(), recent.end(), *it) == recent.end()) {
+            recent.push_back(*it);
+            ASSERT_EQ(small.get(*it), *it);
+        }
+    }
+
+    LRUCache<> restored(100);
+    restored.load_snapshot(path);
+    expect_same_hits(cache, restored, random_trace(10000, 300, 2));
+
+    ASSERT_THROW(restored.load_snapshot(path), std::logic_error);
+    LFUCache<> lfu(100);
+    ASSERT_THROW(lfu.load_snapshot(path), std::runtime_error);
+    fs::remove(path);
+}
+
+TEST(TraceFormatTests, RoundTrip) {
+    auto path = (fs::temp_directory_path() / "caches_trace.bin").string();
+    auto trace = make_trace(Workload::mixed, 1000, 100, 10000);
+    trace.insert(trace.end(), {0, INT32_MIN, INT32_MAX, INT32_MIN, -1, 1});
+    TraceWriter writer(path, 100);
+    for (auto k : trace) {
+        writer.write(k);
+    }
+    writer.finish();
+
+    TraceReader reader(path);
+    ASSERT_EQ(reader.capacity(), 100u);
+    ASSERT_EQ(reader.keys(), trace);
+
+    // the last key lost its byte
+    fs::resize_file(path, fs::file_size(path) - 1);
+    TraceReader truncated(path);
+    ASSERT_THROW(truncated.keys(), std::runtime_error);
+    fs::remove(path);
+}
+
+// the most popular key of every phase is a different one
+TEST(WorkloadTests, PhasesMoveTheHotSet) {
+    const std::size_t phase = 20000;
+    auto trace = make_trace(Workload::phases, 1000, 100, 4 * phase);
+    std::vector<int> hottest;
+    for (std::size_t begin = 0; begin < trace.size(); begin += phase) {
+        std::unordered_map<int, int> counts;
+        for (auto i = begin; i < begin + phase; ++i) {
+            ++counts[trace[i]];
+        }
+        auto top = std::max_element(counts.begin(), counts.end(),
+            [](const auto& a, const auto& b) { return a.second < b.second; });
+        ASSERT_EQ(std::count(hottest.begin(), hottest.end(), top->first), 0);
+        hottest.push_back(top->first);
+    }
+}
+
+// timers over all wheel levels (and beyond the top one) against a sorted map of deadlines
+TEST(TimingWheelTests, MatchesOrderedDeadlines) {
+    const uint32_t capacity = 2000;
+    TimingWheel wheel(capacity);
+    std::map<uint32_t, uint64_t> expected;  // slot -> deadline
+    std::mt19937_64 gen(7);
+    uint64_t now = 12345;
+    wheel.advance(now, [](uint32_t) {});
+    for (int round = 0; round < 20000; ++round) {
+        auto slot = static_cast<uint32_t>(gen() % capacity);
+        if (expected.count(slot) != 0) {
+            wheel.cancel(slot);
+            expected.erase(slot);
+        } else {
+            // ttls from a few ticks to 2^40 ticks
+            auto ttl = uint64_t{1} << (gen() % 40);
+            ttl += gen() % ttl;
+            wheel.schedule(slot, now + ttl);
+            expected[slot] = now + ttl;
+        }
+        now += gen() % 3 == 0 ? uint64_t{1} << (gen() % 38) : gen() % 100;
+        std::vector<uint32_t> expired;
+        wheel.advance(now, [&expired](uint32_t slot) { expired.push_back(slot); });
+        std::sort(expired.begin(), expired.end());
+        std::vector<uint32_t> due;
+        for (auto it = expected.begin(); it != expected.end();) {
+            if (it->second <= now) {
+                due.push_back(it->first);
+                it = expected.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        ASSERT_EQ(expired, due) << "round " << round;
+    }
+}
+
+// a cache without TTLs carries a wheel that was never scheduled on: no buckets and no timers
+TEST(TimingWheelTests, EmptyUntilScheduled) {
+    static_assert(sizeof(TimingWheel) <= 128, "the wheel's buckets are allocated on the first schedule()");
+    TimingWheel wheel(100);
+    wheel.cancel(5);
+    wheel.advance(1000, [](uint32_t) { FAIL(); });
+    ASSERT_TRUE(wheel.empty());
+    wheel.schedule(5, 1010);
+    wheel.cancel(3);
+    std::vector<uint32_t> expired;
+    wheel.advance(1010, [&expired](uint32_t slot) { expired.push_back(slot); });
+    ASSERT_EQ(expired, std::vector<uint32_t>{5});
+}
+
+// random inserts and erases of a full index, deleted positions pile up and force rebuilds
+TEST(FlatIndexTests, MatchesUnorderedMapUnderChurn) {
+    const uint32_t capacity = 1000;
+    FlatIndex<int> index(capacity);
+    std::vector<int> keys(capacity);
+    std::unordered_map<int, uint32_t> expected;
+    auto key_at = [&keys](uint32_t slot) -> const int& { return keys[slot]; };
+    std::mt19937 gen(3);
+    std::uniform_int_distribution<int> dist(0, 5000);
+    for (uint32_t slot = 0; slot < capacity; ++slot) {
+        int key;
+        do {
+            key = dist(gen);
+        } while (expected.count(key) != 0);
+        keys[slot] = key;
+        index.insert(key, slot);
+        expected[key] = slot;
+    }
+    for (int i = 0; i < 100000; ++i) {
+        auto slot = static_cast<uint32_t>(gen() % capacity);
+        index.erase(keys[slot], slot);
+        expected.erase(keys[slot]);
+        int key;
+        do {
+            key = dist(gen);
+        } while (expected.count(key) != 0);
+        ASSERT_EQ(index.find(key, key_at), slab_npos);
+        keys[slot] = key;
+        index.insert(key, slot);
+        expected[key] = slot;
+    }
+    for (int key = 0; key <= 5000; ++key) {
+        auto it = expected.find(key);
+        ASSERT_EQ(index.find(key, key_at), it != expected.end() ? it->second : slab_npos) << "key " << key;
+    }
+}
+
+TEST(LFUCacheTests, EvictsLeastRecentOfLeastFrequent) {
+    LFUCache<std::string, int> cache(3);
+    cache.put("a", 1);
+    cache.put("b", 2);
+    cache.put("c", 3);
+    cache.get("a");
+    cache.get("a");
+    cache.get("b");  // frequencies: a - 3, b - 2, c - 1
+    cache.put("d", 4);
+    ASSERT_EQ(cache.find("c"), nullptr);
+    cache.get("d");  // a - 3, b - 2, d - 2, "b" got its frequency earlier
+    cache.put("e", 5);
+    ASSERT_EQ(cache.find("b"), nullptr);
+    ASSERT_EQ(cache.get("a"), 1);
+    ASSERT_EQ(cache.get("d"), 4);
+    ASSERT_EQ(cache.get("e"), 5);
+}
+
+// Each phase draws keys from its own hot set, so the keys that were popular in the previous
+// phases never come back.
+std::vector<int> shifting_popularity_trace(int phases, int phase_length, int hot_keys) {
+    std::mt19937 gen(2023);
+    std::uniform_int_distribution<int> dist(0, hot_keys - 1);
+    std::vector<int> trace;
+    for (int p = 0; p < phases; ++p) {
+        for (int i = 0; i < phase_length; ++i) {
+            trace.push_back(p * hot_keys + dist(gen));
+        }
+    }
+    return trace;
+}
+
+template<class Cache>
+int count_hits(Cache& cache, const std::vector<int>& trace) {
+    int hits = 0;
+    for (auto k : trace) {
+        if (cache.get(k) != -1) {
+            ++hits;
+        } else {
+            cache.put(k, k);
+        }
+    }
+    return hits;
+}
+
+TEST(LFUCacheTests, WeightedEviction) {
+    LFUCache<> cache(10, LFUAging::none, 100);
+    cache.put(1, 1, 50);
+    cache.get(1);
+    cache.get(1);
+    cache.put(2, 2, 40);
+    cache.put(3, 3, 30);
+    // the least frequently used entry goes, not the oldest one
+    ASSERT_EQ(cache.find(2), nullptr);
+    ASSERT_NE(cache.find(1), nullptr);
+    ASSERT_EQ(cache.weight(), 80u);
+    // entry 1 is still the most frequent one, but it is never evicted for its own update
+    cache.put(1, 1, 80);
+    ASSERT_EQ(cache.find(3), nullptr);
+    ASSERT_EQ(cache.weight(), 80u);
+    cache.put(1, 1, 200);
+    ASSERT_EQ(cache.size(), 0u);
+    ASSERT_EQ(cache.weight(), 0u);
+}
+
+// a weighted put() of the least frequent entry evicts above it and raises the age past its priority:
+// the next insert still goes between the buckets in priority order
+TEST(LFUCacheTests, DynamicAgingWeightedHit) {
+    LFUCache<> cache(10, LFUAging::dynamic, 10);
+    cache.put(2, 2, 2);
+    cache.put(3, 3);
+    for (int i = 0; i < 4; ++i) {
+        cache.get(2);
+        cache.get(3);
+    }
+    cache.put(4, 4);
+    for (int i = 0; i < 8; ++i) {
+        cache.get(4);
+    }
+    cache.put(1, 1);
+    // priorities 1: 2, 2 and 3: 5, 4: 9; the hit evicts 2, the least recent one of the second bucket
+    cache.put(1, 1, 7);
+    ASSERT_EQ(cache.find(2), nullptr);
+    cache.put(5, 5);
+    std::vector<int> order;
+    cache.for_each([&order](int key, int) { order.push_back(key); });
+    ASSERT_EQ(order, (std::vector<int>{4, 5, 3, 1}));
+}
+
+// small popular keys and big less popular ones: LFU keeps the small ones, so its object hit ratio
+// is well above the byte hit ratio
+TEST(LFUCacheTests, ObjectAndByteHitRatios) {
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<int> small_keys(0, 99), big_keys(1000, 1099);
+    std::vector<int> trace(100000);
+    for (auto& k : trace) {
+        k = gen() % 4 == 0 ? big_keys(gen) : small_keys(gen);
+    }
+    auto weight_of = [](int k) -> uint32_t { return k >= 1000 ? 1000 : 10; };
+    LRUCache<> lru(1000, 20000);
+    LFUCache<> lfu(1000, LFUAging::none, 20000);
+    for (auto k : trace) {
+        lru.access(k, [k] { return k; }, weight_of(k));
+        lfu.access(k, [k] { return k; }, weight_of(k));
+    }
+    RecordProperty("lru_hit_ratio", std::to_string(lru.stats().hit_ratio()));
+    RecordProperty("lru_byte_hit_ratio", std::to_string(lru.stats().byte_hit_ratio()));
+    RecordProperty("lfu_hit_ratio", std::to_string(lfu.stats().hit_ratio()));
+    RecordProperty("lfu_byte_hit_ratio", std::to_string(lfu.stats().byte_hit_ratio()));
+    ASSERT_EQ(lfu.stats().hits + lfu.stats().misses, trace.size());
+    ASSERT_GT(lfu.stats().hit_ratio(), 0.7);
+    ASSERT_LT(lfu.stats().byte_hit_ratio(), lfu.stats().hit_ratio());
+    ASSERT_GE(lfu.stats().hit_ratio(), lru.stats().hit_ratio());
+}
+
+TEST(LFUCacheTests, ExpiresEntries) {
+    uint64_t now = 0;
+    LFUCache<> cache(2);
+    cache.set_clock([&now] { return now; });
+    cache.access(1, [] { return 1; }, 1, 10);
+    for (int i = 0; i < 5; ++i) {
+        cache.get(1);
+    }
+    cache.put(2, 2);
+    now = 10;
+    // the frequent entry expired, there is room for both new ones
+    cache.put(3, 3);
+    ASSERT_EQ(cache.find(1), nullptr);
+    ASSERT_NE(cache.find(2), nullptr);
+    ASSERT_NE(cache.find(3), nullptr);
+}
+
+TEST(LFUCacheTests, DynamicAgingOnShiftingPopularity) {
+    const int phases = 4, phase_length = 20000, hot_keys = 16, capacity = 16;
+    auto trace = shifting_popularity_trace(phases, phase_length, hot_keys);
+    LFUCache<> lfu(capacity);
+    LFUCache<> lfu_da(capacity, LFUAging::dynamic);
+    int lfu_hits = count_hits(lfu, trace);
+    int lfu_da_hits = count_hits(lfu_da, trace);
+    RecordProperty("lfu_hit_rate", std::to_string(static_cast<double>(lfu_hits) / trace.size()));
+    RecordProperty("lfu_da_hit_rate", std::to_string(static_cast<double>(lfu_da_hits) / trace.size()));
+    // plain LFU keeps the first phase keys forever and almost never hits after the first shift
+    ASSERT_LT(lfu_hits, phase_length + (phases - 1) * phase_length / 10);
+    ASSERT_GT(lfu_da_hits, phases * phase_length * 9 / 10);
+}
+
+TEST(LFUCacheTests, DynamicAgingOnStablePopularity) {
+    // without traffic shifts LFU-DA keeps the frequent keys just like LFU
+    std::mt19937 gen(2023);
+    std::discrete_distribution<int> dist({50, 20, 10, 5, 5, 2, 2, 2, 1, 1, 1, 1});
+    std::vector<int> trace(50000);
+    for (auto& k : trace) {
+        k = dist(gen);
+    }
+    LFUCache<> lfu(4);
+    LFUCache<> lfu_da(4, LFUAging::dynamic);
+    int lfu_hits = count_hits(lfu, trace);
+    int lfu_da_hits = count_hits(lfu_da, trace);
+    ASSERT_GE(lfu_da_hits, lfu_hits * 95 / 100);
+}
+
+// LFU-DA by the definition: on every hit priority = age + frequency, the victim is the lowest priority,
+// the least recently prioritised on ties, and its priority becomes the age
+int lfu_da_reference_hits(std::size_t capacity, const std::vector<int>& trace) {
+    struct Entry {
+        uint64_t freq, priority, stamp;
+    };
+    std::unordered_map<int, Entry> entries;
+    uint64_t age = 0, stamp = 0;
+    int hits = 0;
+    for (auto k : trace) {
+        if (auto it = entries.find(k); it != entries.end()) {
+            ++hits;
+            auto& e = it->second;
+            ++e.freq;
+            e.priority = age + e.freq;
+            e.stamp = ++stamp;
+            continue;
+        }
+        if (entries.size() == capacity) {
+            auto victim = std::min_element(entries.begin(), entries.end(), [](auto& a, auto& b) {
+                return std::tie(a.second.priority, a.second.stamp) < std::tie(b.second.priority, b.second.stamp);
+            });
+            age = victim->second.priority;
+            entries.erase(victim);
+        }
+        entries[k] = {1, age + 1, ++stamp};
+    }
+    return hits;
+}
+
+// a key hit after a long pause gets the current age, not the priority it had back then
+TEST(LFUCacheTests, DynamicAgingMatchesDefinition) {
+    for (auto trace : {random_trace(20000, 200, 6), shifting_popularity_trace(4, 5000, 16)}) {
+        for (std::size_t capacity : {4, 16, 50}) {
+            LFUCache<> cache(capacity, LFUAging::dynamic);
+            ASSERT_EQ(count_hits(cache, trace), lfu_da_reference_hits(capacity, trace)) << capacity;
+        }
+    }
+}
+
+TEST(LFUCacheTests, SnapshotRoundTrip) {
+    auto path = (fs::temp_directory_path() / "caches_lfu_snapshot.bin").string();
+    FlatLFUCache cache(100, LFUAging::dynamic);
+    for (auto k : random_trace(20000, 300, 4)) {
+        cache.access(k, [k] { return k; });
+    }
+    cache.save_snapshot(path);
+    FlatLFUCache restored(100, LFUAging::dynamic);
+    restored.load_snapshot(path);
+    expect_same_hits(cache, restored, random_trace(20000, 300, 5));
+    fs::remove(path);
+}
+
+TEST(ARCCacheTests, ResistsScans) {
+    // a small hot set interleaved with long one-off scans: LRU flushes the hot keys on every scan
+    std::vector<int> trace;
+    int scan_key = 1000;
+    for (int round = 0; round < 200; ++round) {
+        for (int rep = 0; rep < 3; ++rep) {
+            for (int k = 0; k < 8; ++k) {
+                trace.push_back(k);
+            }
+        }
+        for (int i = 0; i < 20; ++i) {
+            trace.push_back(scan_key++);
+        }
+    }
+    LRUCache<> lru(16);
+    ARCCache<> arc(16);
+    int lru_hits = count_hits(lru, trace);
+    int arc_hits = count_hits(arc, trace);
+    ASSERT_GT(arc_hits, lru_hits + lru_hits / 5);
+}
+
+TEST(FrequencySketchTests, EstimatesAndAges) {
+    FrequencySketch<int> sketch(64);
+    for (int i = 0; i < 5; ++i) {
+        sketch.increment(1);
+    }
+    sketch.increment(2);
+    ASSERT_GE(sketch.estimate(1), 5);
+    ASSERT_GE(sketch.estimate(2), 1);
+    ASSERT_LT(sketch.estimate(2), sketch.estimate(1));
+    // counters saturate at 15 and are halved every 10 * capacity additions
+    for (int i = 0; i < 20; ++i) {
+        sketch.increment(1);
+    }
+    ASSERT_EQ(sketch.estimate(1), 15);
+    for (int k = 100; sketch.estimate(1) == 15; ++k) {
+        sketch.increment(k);
+    }
+    ASSERT_EQ(sketch.estimate(1), 7);
+}
+
+TEST(TinyLFUCacheTests, KeepsFrequentKeysOnScans) {
+    std::vector<int> trace;
+    int scan_key = 1000;
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> hot(0, 31);
+    for (int round = 0; round < 500; ++round) {
+        for (int i = 0; i < 40; ++i) {
+            trace.push_back(hot(gen));
+        }
+        for (int i = 0; i < 40; ++i) {
+            trace.push_back(scan_key++);
+        }
+    }
+    LRUCache<> lru(40);
+    TinyLFUCache<> tinylfu(40);
+    int lru_hits = count_hits(lru, trace);
+    int tinylfu_hits = count_hits(tinylfu, trace);
+    // nearly every hot key access hits, LRU loses them to scans
+    ASSERT_GT(tinylfu_hits, static_cast<int>(trace.size()) / 2 * 9 / 10);
+    ASSERT_LT(lru_hits, tinylfu_hits / 2);
+}
+
+TEST(MissRatioCurveTests, MatchesLRUReplay) {
+    std::mt19937 gen(11);
+    std::discrete_distribution<int> hot({8, 4, 2, 1});
+    std::uniform_int_distribution<int> key(0, 49);
+    std::vector<int> trace(20000);
+    for (auto& k : trace) {
+        // 4 groups of 50 keys with different popularity
+        k = hot(gen) * 50 + key(gen);
+    }
+    const std::size_t max_capacity = 210;
+    auto hits = lru_hits_curve(trace, max_capacity);
+    ASSERT_EQ(hits.size(), max_capacity + 1);
+    ASSERT_EQ(hits[0], 0u);
+    for (std::size_t c = 1; c <= max_capacity; ++c) {
+        LRUCache<> lru(c);
+        ASSERT_EQ(hits[c], static_cast<uint64_t>(count_hits(lru, trace))) << "capacity " << c;
+    }
+}
+
+std::vector<int> zipf_trace(int keys_count, int length, double alpha, unsigned seed) {
+    std::vector<double> weights(keys_count);
+    for (int i = 0; i < keys_count; ++i) {
+        weights[i] = 1.0 / std::pow(i + 1, alpha);
+    }
+    std::mt19937 gen(seed);
+    std::discrete_distribution<int> dist(weights.begin(), weights.end());
+    // scatter popular keys over the key space
+    std::vector<int> trace(length);
+    for (auto& k : trace) {
+        k = dist(gen) * 7919 % 1000003;
+    }
+    return trace;
+}
+
+class ShardsTests : public testing::Test {
+protected:
+    void SetUp() override {
+        trace = zipf_trace(20000, 300000, 0.9, 5);
+        exact = lru_hits_curve(trace, capacities.back());
+    }
+
+    // mean absolute error of the hit ratio over the capacities, also put into the test report
+    double report_error(const std::string& name, const std::vector<uint64_t>& estimated_hits) {
+        double error = 0;
+        for (auto c : capacities) {
+            double diff = (static_cast<double>(estimated_hits[c]) - exact[c]) / trace.size();
+            error += std::abs(diff);
+        }
+        error /= capacities.size();
+        RecordProperty(name, std::to_string(error));
+        return error;
+    }
+
+    const std::vector<std::size_t> capacities{100, 250, 500, 1000, 2000, 4000, 8000};
+    std::vector<int> trace;
+    std::vector<uint64_t> exact;
+};
+
+TEST_F(ShardsTests, FixedRateCurve) {
+    auto estimated = shards_hits_curve(trace, capacities.back(), 0.1);
+    ASSERT_LT(report_error("fixed_rate_0.1", estimated), 0.02);
+}
+
+TEST_F(ShardsTests, FixedSizeCurve) {
+    auto estimated = shards_hits_curve(trace, capacities.back(), 1.0, 2000);
+    ASSERT_LT(report_error("fixed_size_2000", estimated), 0.02);
+}
+
+TEST_F(ShardsTests, SampledLRUReplay) {
+    // exact LRUCache replay per capacity against the scaled down simulation
+    std::vector<uint64_t> estimated(capacities.back() + 1, 0);
+    for (auto c : capacities) {
+        LRUCache<> lru(c);
+        ASSERT_EQ(exact[c], static_cast<uint64_t>(count_hits(lru, trace)));
+        estimated[c] = shards_hits<LRUCache<>>(trace, c, 0.1);
+    }
+    ASSERT_LT(report_error("lru_replay_0.1", estimated), 0.02);
+}
+
+// 4 threads over overlapping keys, every value read must be the one cached for its key;
+// get_or_put(cache, k) returns the cached value or caches k * 2 and returns it
+template<class Cache, class GetOrPut>
+void expect_concurrent_get_put(Cache& cache, GetOrPut&& get_or_put) {
+    const int threads_count = 4;
+    std::vector<std::thread> threads;
+    std::vector<int> wrong_values(threads_count, 0);
+    for (int t = 0; t < threads_count; ++t) {
+        threads.emplace_back([&cache, &get_or_put, &wrong_values, t] {
+            for (int i = 0; i < 100000; ++i) {
+                int k = (i * 7 + t) % 500;
+                if (get_or_put(cache, k) != k * 2) {
+                    ++wrong_values[t];
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    ASSERT_EQ(std::count(wrong_values.begin(), wrong_values.end(), 0), threads_count);
+}
+
+// through access()
+template<class Cache>
+void expect_concurrent_get_put(Cache& cache) {
+    expect_concurrent_get_put(cache, [](Cache& c, int k) { return c.access(k, [k] { return k * 2; }).first; });
+}
+
+TEST(ShardedLRUCacheTests, ConcurrentGetPut) {
+    ShardedLRUCache<> cache(8, 16);
+    expect_concurrent_get_put(cache, [](ShardedLRUCache<>& c, int k) {
+        if (auto v = c.find(k)) {
+            return *v;
+        }
+        c.put(k, k * 2);
+        return k * 2;
+    });
+    ASSERT_LE(cache.size(), 8u * 16);
+}
+
+TEST(ClockCacheTests, SecondChance) {
+    ClockCache<> cache(3);
+    for (int k = 1; k <= 3; ++k) {
+        cache.put(k, k);
+    }
+    ASSERT_EQ(cache.get(1), 1);
+    // the hand clears the bit of 1 and evicts 2
+    cache.put(4, 4);
+    ASSERT_EQ(cache.get(2), -1);
+    ASSERT_EQ(cache.get(1), 1);
+    ASSERT_EQ(cache.get(3), 3);
+    ASSERT_EQ(cache.get(4), 4);
+    ASSERT_EQ(cache.size(), 3u);
+}
+
+// a loop a bit longer than the cache: LRU and CLOCK always evict the key needed next,
+// CLOCK-Pro keeps a part of the loop hot
+TEST(ClockProCacheTests, ResistsLoops) {
+    auto trace = make_trace(Workload::loop, 1000, 100, 20000);
+    LRUCache<> lru(100);
+    ClockCache<> clock(100);
+    ClockProCache<> clock_pro(100);
+    ASSERT_EQ(count_hits(lru, trace), 0);
+    ASSERT_EQ(count_hits(clock, trace), 0);
+    ASSERT_GT(count_hits(clock_pro, trace), static_cast<int>(trace.size() / 4));
+    ASSERT_LE(clock_pro.size(), 100u);
+}
+
+TEST(ClockProCacheTests, KeepsHotKeysOnScans) {
+    std::vector<int> trace;
+    int scan_key = 1000;
+    for (int round = 0; round < 200; ++round) {
+        for (int rep = 0; rep < 3; ++rep) {
+            for (int k = 0; k < 8; ++k) {
+                trace.push_back(k);
+            }
+        }
+        for (int i = 0; i < 20; ++i) {
+            trace.push_back(scan_key++);
+        }
+    }
+    LRUCache<> lru(16);
+    ClockProCache<> clock_pro(16);
+    int lru_hits = count_hits(lru, trace);
+    int clock_pro_hits = count_hits(clock_pro, trace);
+    ASSERT_GT(clock_pro_hits, lru_hits + lru_hits / 5);
+}
+
+// the tiniest shards take every hand path: promotions, demotions, readmissions and ended test periods
+TEST(ClockProCacheTests, SmallCapacities) {
+    for (std::size_t capacity : {1, 2, 3, 5}) {
+        ClockProCache<> cache(capacity);
+        for (auto k : random_trace(20000, 4 * static_cast<int>(capacity), static_cast<unsigned>(capacity))) {
+            if (cache.get(k) == -1) {
+                cache.put(k, k * 2);
+            }
+            ASSERT_EQ(cache.get(k), k * 2);
+            ASSERT_LE(cache.size(), capacity);
+        }
+        ASSERT_EQ(cache.size(), capacity);
+    }
+}
+
+TEST(ClockCacheTests, ConcurrentAccess) {
+    ClockCache<> cache(8, 16);
+    expect_concurrent_get_put(cache);
+    ASSERT_LE(cache.size(), 8u * 16);
+}
+
+TEST(ClockProCacheTests, ConcurrentAccess) {
+    ClockProCache<> cache(8, 16);
+    expect_concurrent_get_put(cache);
+    ASSERT_LE(cache.size(), 8u * 16);
+}
+
+TEST(FrontCacheTests, ServesHotKeysFromFront) {
+    FrontCache<> cache(4, 64, 32);
+    for (int k = 0; k < 10; ++k) {
+        cache.put(k, k);
+    }
+    for (int round = 0; round < 100; ++round) {
+        for (int k = 0; k < 10; ++k) {
+            ASSERT_EQ(cache.get(k), k);
+        }
+    }
+    // a key that lost its L1 slot to another one (or never had it) goes to the L2 once
+    ASSERT_GE(cache.front_stats().hits, 990u);
+    ASSERT_EQ(cache.get(100), -1);
+}
+
+TEST(FrontCacheTests, WritesAreCoherent) {
+    FrontCache<int, int, LFUCache<>> cache(2, 16);
+    cache.put(1, 0);
+    ASSERT_EQ(cache.get(1), 0);
+
+    // a reader never goes back to an older value while another thread writes
+    const int writes = 20000;
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        int last = 0;
+        while (!done.load()) {
+            auto value = cache.get(1);
+            ASSERT_GE(value, last);
+            last = value;
+        }
+    });
+    std::thread writer([&] {
+        for (int i = 1; i <= writes; ++i) {
+            cache.put(1, i);
+        }
+        done.store(true);
+    });
+    writer.join();
+    reader.join();
+    // the value in this thread's L1 is stale, its stripe version tells
+    ASSERT_EQ(cache.get(1), writes);
+    ASSERT_EQ(cache.access(1, [] { return -1; }), std::make_pair(writes, true));
+}
+
+// a key evicted from the L2 and cached again by access() in another thread invalidates this thread's L1
+TEST(FrontCacheTests, AccessMissInvalidatesFront) {
+    FrontCache<> cache(1, 1);
+    cache.put(1, 10);
+    ASSERT_EQ(cache.get(1), 10);
+    std::thread other([&cache] {
+        cache.put(2, 20);
+        cache.access(1, [] { return 11; });
+    });
+    other.join();
+    ASSERT_EQ(cache.get(1), 11);
+    ASSERT_EQ(cache.front_stats().misses, 1u);
+}
+
+// a single thread drains its buffered hits before every eviction: exactly LFU (and LFU-DA)
+TEST(ConcurrentLFUCacheTests, MatchesLFUOnOneThread) {
+    auto trace = random_trace(50000, 500, 3);
+    for (auto aging : {LFUAging::none, LFUAging::dynamic}) {
+        LFUCache<> lfu(50, aging);
+        ConcurrentLFUCache<> concurrent(50, aging, 4);
+        ASSERT_EQ(count_hits(concurrent, trace), count_hits(lfu, trace));
+        ASSERT_EQ(concurrent.size(), 50u);
+    }
+}
+
+TEST(ConcurrentLFUCacheTests, ConcurrentAccess) {
+    ConcurrentLFUCache<> cache(64, LFUAging::none, 2);
+    expect_concurrent_get_put(cache);
+    ASSERT_EQ(cache.size(), 64u);
+}
+
+// an in-memory Store that counts the batches
+struct MemoryStore {
+    std::optional<int> load(const int& key) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = values.find(key);
+        return it != values.end() ? std::optional<int>(it->second) : std::nullopt;
+    }
+    void store(const std::vector<std::pair<int, int>>& batch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& [key, value] : batch) {
+            values[key] = value;
+        }
+        ++batches;
+        written += batch.size();
+    }
+
+    mutable std::mutex mutex;
+    std::unordered_map<int, int> values;
+    std::size_t batches = 0;
+    std::size_t written = 0;
+};
+
+TEST(WriteBackCacheTests, WritesEvictedAndFlushedValues) {
+    MemoryStore store;
+    {
+        WriteBackCache<int, int, MemoryStore> cache(10, store, 8, std::chrono::seconds(10));
+        for (int i = 0; i < 100; ++i) {
+            cache.put(i, i * 2);
+        }
+        // evicted dirty values are read back before or after they're written
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_EQ(cache.get(i), i * 2);
+        }
+        ASSERT_EQ(cache.get(100), std::nullopt);
+        // rewrites of resident entries coalesce in the cache
+        for (int i = 0; i < 1000; ++i) {
+            cache.put(i % 5, i);
+        }
+        cache.flush();
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_EQ(store.load(i), i < 5 ? 995 + i : i * 2) << i;
+        }
+        ASSERT_LE(store.written, 120u);
+        ASSERT_LT(store.batches, store.written / 2);
+        ASSERT_EQ(cache.batches(), store.batches);
+
+        // clean entries aren't written again
+        auto written = store.written;
+        for (int i = 0; i < 100; ++i) {
+            cache.get(i);
+        }
+        cache.flush();
+        ASSERT_EQ(store.written, written);
+        cache.put(7, -7);
+    }
+    // the destructor flushes
+    ASSERT_EQ(store.load(7), -7);
+}
+
+struct FailingStore : MemoryStore {
+    void store(const std::vector<std::pair<int, int>>& batch) {
+        ++attempts;
+        if (failures > 0) {
+            --failures;
+            throw std::runtime_error("store is down");
+        }
+        MemoryStore::store(batch);
+    }
+
+    int failures = 1;
+    std::atomic<int> attempts{0};
+};
+
+TEST(WriteBackCacheTests, RetriesFailedBatches) {
+    FailingStore store;
+    WriteBackCache<int, int, FailingStore> cache(4, store, 4, std::chrono::milliseconds(1));
+    for (int i = 0; i < 10; ++i) {
+        cache.put(i, i);
+    }
+    ASSERT_THROW(cache.flush(), std::runtime_error);
+    cache.flush();
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_EQ(store.load(i), i);
+    }
+}
+
+// a store that stays down is retried once per flush interval, not in a loop
+TEST(WriteBackCacheTests, BacksOffAfterFailures) {
+    FailingStore store;
+    store.failures = 1000000;
+    {
+        WriteBackCache<int, int, FailingStore> cache(4, store, 4, std::chrono::milliseconds(20));
+        for (int i = 0; i < 10; ++i) {
+            cache.put(i, i);
+        }
+        ASSERT_THROW(cache.flush(), std::runtime_error);
+        ASSERT_THROW(cache.flush(), std::runtime_error);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    // about 8 in the 140ms or so, a generous bound for slow machines
+    ASSERT_LT(store.attempts.load(), 50);
+}
+
+TEST(FileStoreTests, ReopenRestoresLastValues) {
+    auto path = (fs::temp_directory_path() / "caches_file_store.bin").string();
+    fs::remove(path);
+    {
+        FileStore<int, int> store(path, false);
+        WriteBackCache<int, int, FileStore<int, int>> cache(16, store, 32);
+        for (int i = 0; i < 1000; ++i) {
+            cache.put(i % 200, i);
+        }
+    }
+    // a torn record at the end is dropped
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out.write("abc", 3);
+    }
+    FileStore<int, int> store(path, false);
+    auto records_size = fs::file_size(path);
+    ASSERT_EQ(records_size % (2 * sizeof(int)), 0u);
+    ASSERT_EQ(store.size(), 200u);
+    for (int i = 0; i < 200; ++i) {
+        ASSERT_EQ(store.load(i), 800 + i);
+    }
+    ASSERT_EQ(store.load(200), std::nullopt);
+    store.store({{200, 1}});
+    ASSERT_EQ(store.load(200), 1);
+    ASSERT_EQ(fs::file_size(path), records_size + 2 * sizeof(int));
+    fs::remove(path);
+}
+
+TEST(TieredCacheTests, DemotesAndPromotes) {
+    auto path = (fs::temp_directory_path() / "caches_tiered.bin").string();
+    fs::remove(path);
+    {
+        TieredCache<> cache(10, path, 2, 8);
+        for (int i = 0; i < 100; ++i) {
+            cache.put(i, i * 3);
+        }
+        ASSERT_EQ(cache.memory_size(), 10u);
+        cache.flush();
+        ASSERT_EQ(cache.disk_size(), 100u);
+
+        // 90..99 are in memory, the rest comes back from the log
+        for (int i = 100; i-- > 0;) {
+            ASSERT_EQ(cache.get(i).get(), i * 3) << i;
+        }
+        ASSERT_EQ(cache.get(100).get(), std::nullopt);
+        auto stats = cache.stats();
+        ASSERT_EQ(stats.memory_hits, 10u);
+        ASSERT_EQ(stats.disk_hits, 90u);
+        ASSERT_EQ(stats.misses, 1u);
+        // a promoted key is a memory hit
+        ASSERT_EQ(cache.get(0).get(), 0);
+        ASSERT_EQ(cache.stats().memory_hits, 11u);
+
+        // promoted entries are demoted again without being written
+        cache.flush();
+        auto size = fs::file_size(path);
+        for (int i = 0; i < 20; ++i) {
+            cache.get(i).get();
+        }
+        cache.flush();
+        ASSERT_EQ(fs::file_size(path), size);
+        cache.put(5, -5);
+    }
+    // the log keeps what the cache held
+    TieredCache<> reopened(10, path);
+    ASSERT_EQ(reopened.get(5).get(), -5);
+    ASSERT_EQ(reopened.get(50).get(), 150);
+    fs::remove(path);
+}
+
+// a MemoryStore whose loads read the value, then wait until open()
+struct GatedStore : MemoryStore {
+    std::optional<int> load(const int& key) const {
+        auto value = MemoryStore::load(key);
+        std::unique_lock<std::mutex> lock(gate_mutex);
+        ++loads;
+        gate.notify_all();
+        gate.wait(lock, [this] { return !closed; });
+        return value;
+    }
+    bool contains(const int& key) const { return MemoryStore::load(key).has_value(); }
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return values.size();
+    }
+
+    // with writes_closed batches wait for open_writes()
+    void store(const std::vector<std::pair<int, int>>& batch) {
+        {
+            std::unique_lock<std::mutex> lock(gate_mutex);
+            ++stores;
+            gate.notify_all();
+            gate.wait(lock, [this] { return !writes_closed; });
+        }
+        MemoryStore::store(batch);
+    }
+
+    void wait_for_loads(int n) const {
+        std::unique_lock<std::mutex> lock(gate_mutex);
+        gate.wait(lock, [this, n] { return loads >= n; });
+    }
+    void wait_for_stores(int n) const {
+        std::unique_lock<std::mutex> lock(gate_mutex);
+        gate.wait(lock, [this, n] { return stores >= n; });
+    }
+    void open() {
+        std::lock_guard<std::mutex> lock(gate_mutex);
+        closed = false;
+        gate.notify_all();
+    }
+    void open_writes() {
+        std::lock_guard<std::mutex> lock(gate_mutex);
+        writes_closed = false;
+        gate.notify_all();
+    }
+
+    mutable std::mutex gate_mutex;
+    mutable std::condition_variable gate;
+    mutable int loads = 0;
+    int stores = 0;
+    bool closed = true;
+    bool writes_closed = false;
+};
+
+// the value put while the old one is being read wins, even once it went to the store
+TEST(TieredCacheTests, PutWinsOverReadInFlight) {
+    GatedStore store;
+    store.store({{1, 10}});
+    TieredCache<int, int, std::hash<int>, GatedStore> cache(2, store, 1, 1);
+    auto result = cache.get(1);
+    store.wait_for_loads(1);
+    cache.put(1, 20);
+    cache.put(2, 2);
+    cache.put(3, 3);
+    cache.flush();
+    ASSERT_EQ(cache.memory_size(), 2u);
+    ASSERT_EQ(store.MemoryStore::load(1), 20);
+    store.open();
+    ASSERT_EQ(result.get(), 20);
+    ASSERT_EQ(cache.get(1).get(), 20);
+    ASSERT_EQ(store.loads, 2);
+}
+
+// flush() waits for the log without the memory tier's lock: hits are served meanwhile
+TEST(TieredCacheTests, FlushDoesNotBlockHits) {
+    GatedStore store;
+    store.open();
+    store.writes_closed = true;
+    TieredCache<int, int, std::hash<int>, GatedStore> cache(4, store, 1, 64);
+    cache.put(1, 1);
+    cache.put(2, 2);
+    std::thread flusher([&cache] { cache.flush(); });
+    store.wait_for_stores(1);
+    auto hit = std::async(std::launch::async, [&cache] {
+        cache.put(3, 3);
+        return cache.get(1).get();
+    });
+    auto status = hit.wait_for(std::chrono::seconds(5));
+    store.open_writes();
+    flusher.join();
+    ASSERT_EQ(status, std::future_status::ready);
+    ASSERT_EQ(hit.get(), 1);
+    ASSERT_EQ(store.load(1), 1);
+    ASSERT_EQ(store.load(2), 2);
+}
+
+TEST(TieredCacheTests, ConcurrentAccess) {
+    auto path = (fs::temp_directory_path() / "caches_tiered_concurrent.bin").string();
+    fs::remove(path);
+    {
+        const int threads_count = 4;
+        TieredCache<> cache(32, path, 2, 16);
+        std::vector<std::thread> threads;
+        std::vector<int> wrong_values(threads_count, 0);
+        for (int t = 0; t < threads_count; ++t) {
+            threads.emplace_back([&cache, &wrong_values, t] {
+                for (int i = 0; i < 5000; ++i) {
+                    int k = (i * 7 + t) % 300;
+                    auto value = cache.get(k).get();
+                    if (!value) {
+                        cache.put(k, k * 2);
+                    } else if (*value != k * 2) {
+                        ++wrong_values[t];
+                    }
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        ASSERT_EQ(std::count(wrong_values.begin(), wrong_values.end(), 0), threads_count);
+        ASSERT_EQ(cache.memory_size(), 32u);
+    }
+    fs::remove(path);
+}
+
+// every configuration replayed on the pool gets the hits of a sequential replay
+TEST(ReplayTests, ParallelMatchesSequential) {
+    auto trace = make_trace(Workload::mixed, 2000, 200, 20000);
+    std::vector<ReplayConfig> configs;
+    for (std::size_t capacity : {10, 100, 500}) {
+        for (auto& policy : replay_policies()) {
+            configs.push_back({policy, capacity});
+        }
+    }
+    auto hits = replay_parallel(trace, configs, 4);
+    ASSERT_EQ(hits.size(), configs.size());
+    for (std::size_t i = 0; i < configs.size(); ++i) {
+        ASSERT_EQ(hits[i], replay_hits(configs[i], trace)) << configs[i].policy << " " << configs[i].capacity;
+    }
+
+    LRUCache<> lru(100);
+    ASSERT_EQ(hits[replay_policies().size()], access_hits(lru, trace));
+    ASSERT_THROW(replay_parallel(trace, {{"fifo", 10}}), std::invalid_argument);
+}
+
+// remapping the keys is a bijection: the same hits for every policy that doesn't hash the keys itself
+TEST(ReplayTests, DenseMatchesHashed) {
+    auto trace = make_trace(Workload::phases, 3000, 300, 30000);
+    auto dense = remap_dense(trace);
+    ASSERT_EQ(dense.universe, std::unordered_set<int>(trace.begin(), trace.end()).size());
+    ASSERT_LT(*std::max_element(dense.keys.begin(), dense.keys.end()), dense.universe);
+
+    std::vector<ReplayConfig> configs;
+    for (std::size_t capacity : {1, 30, 300}) {
+        for (std::string policy : {"lru", "lfu", "lfu_da", "arc", "perfect"}) {
+            configs.push_back({policy, capacity});
+        }
+    }
+    ASSERT_EQ(replay_parallel(dense, configs, 2), replay_parallel(trace, configs, 2));
+}
+
+// a binary trace replayed from its mapping, and remapped while it's decoded, as if it were in memory
+TEST(ReplayTests, MappedTraceMatchesInMemory) {
+    auto path = (fs::temp_directory_path() / "caches_replay.bin").string();
+    auto trace = make_trace(Workload::mixed, 2000, 200, 20000);
+    TraceWriter writer(path, 200);
+    for (auto k : trace) {
+        writer.write(k);
+    }
+    writer.finish();
+
+    TraceReader reader(path);
+    std::vector<ReplayConfig> configs;
+    for (const auto& policy : replay_policies()) {
+        configs.push_back({policy, 200});
+    }
+    ASSERT_EQ(replay_parallel(reader, configs, 2), replay_parallel(trace, configs, 2));
+    auto dense = remap_dense<int>(reader.size(), [&reader](auto&& f) { reader.for_each(f); });
+    ASSERT_EQ(dense.keys, remap_dense(trace).keys);
+    fs::remove(path);
+}
+
+TEST(LoadingCacheTests, ConcurrentMissesLoadOnce) {
+    const int threads_count = 8;
+    LoadingCache<> cache(4, 16);
+    std::atomic<int> loads{0};
+    auto slow_loader = [&loads](int key) {
+        ++loads;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        return key * 3;
+    };
+    std::vector<std::thread> threads;
+    std::vector<int> values(threads_count, 0);
+    for (int t = 0; t < threads_count; ++t) {
+        threads.emplace_back([&, t] { values[t] = cache.get_or_load(7, slow_loader); });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    ASSERT_EQ(loads.load(), 1);
+    ASSERT_EQ(std::count(values.begin(), values.end(), 21), threads_count);
+    ASSERT_EQ(cache.get_or_load(7, slow_loader), 21);
+    ASSERT_EQ(loads.load(), 1);
+}
+
+TEST(LoadingCacheTests, FailedLoadIsNotCached) {
+    LoadingCache<> cache(2, 16);
+    int loads = 0;
+    auto failing_loader = [&loads](int) -> int {
+        ++loads;
+        throw std::runtime_error("backend is down");
+    };
+    ASSERT_THROW(cache.get_or_load(1, failing_loader), std::runtime_error);
+    ASSERT_THROW(cache.get_or_load(1, failing_loader), std::runtime_error);
+    ASSERT_EQ(loads, 2);
+    ASSERT_EQ(cache.get_or_load(1, [](int key) { return key + 1; }), 2);
+    ASSERT_EQ(cache.size(), 1u);
+}
+
+TEST(LoadingCacheTests, GetManyLoadsMissesInOneBatch) {
+    LoadingCache<> cache(4, 16);
+    for (int key : {1, 2}) {
+        cache.get_or_load(key, [](int k) { return k * 10; });
+    }
+    std::vector<std::vector<int>> batches;
+    auto batch_loader = [&batches](const std::vector<int>& keys) {
+        batches.push_back(keys);
+        std::vector<int> values;
+        for (int key : keys) {
+            values.push_back(key * 10);
+        }
+        return values;
+    };
+    auto values = cache.get_many({3, 1, 4, 3, 2, 5}, batch_loader);
+    ASSERT_EQ(values, (std::vector<int>{30, 10, 40, 30, 20, 50}));
+    ASSERT_EQ(batches, (std::vector<std::vector<int>>{{3, 4, 5}}));
+
+    ASSERT_EQ(cache.get_many({5, 4}, batch_loader), (std::vector<int>{50, 40}));
+    ASSERT_EQ(batches.size(), 1u);
+    ASSERT_THROW(cache.get_many({6, 7}, [](const std::vector<int>&) { return std::vector<int>{60}; }),
+                 std::length_error);
+    ASSERT_EQ(cache.get_many({6}, batch_loader), (std::vector<int>{60}));
+}
+
 // Value parametrized tests, has more clear output, but can't be type parametrize.
 
 // TEST_P(CacheFixtureTests, LRUEnd2EndTest) {
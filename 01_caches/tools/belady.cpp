@@ -0,0 +1,72 @@
+#include <perfect_cache.hpp>
+#include <trace_format.hpp>
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Offline optimal (Belady) hits for a trace, with the simulation time and peak RSS.
+// Reads "capacity n k1 ... kn" from stdin like the caches binary, or generates
+// n uniformly random keys from [0, universe) with --random capacity n universe,
+// or reads a binary trace (see trace_format.hpp) with --trace trace.bin.
+
+long peak_rss_kb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+int main(int argc, char* argv[]) {
+    std::size_t capacity, n;
+    std::vector<int> keys;
+    if (argc == 5 && std::string(argv[1]) == "--random") {
+        capacity = std::stoul(argv[2]);
+        n = std::stoul(argv[3]);
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<int> dist(0, std::stoi(argv[4]) - 1);
+        keys.resize(n);
+        for (auto& k : keys) {
+            k = dist(gen);
+        }
+    } else if (argc == 3 && std::string(argv[1]) == "--trace") {
+        TraceReader trace(argv[2]);
+        capacity = trace.capacity();
+        n = trace.size();
+        keys = trace.keys();
+    } else if (argc == 1) {
+        std::cin >> capacity >> n;
+        keys.resize(n);
+        for (auto& k : keys) {
+            std::cin >> k;
+        }
+    } else {
+        std::cerr << "Usage: " << argv[0] << " [--random capacity n universe | --trace trace.bin] < trace\n";
+        return EXIT_FAILURE;
+    }
+    auto rss_before = peak_rss_kb();
+
+    auto start = std::chrono::steady_clock::now();
+    PerfectCache<> cache(capacity, keys);
+    auto prepared = std::chrono::steady_clock::now();
+    std::size_t hits = 0;
+    for (auto k : keys) {
+        if (cache.find(k) != nullptr) {
+            ++hits;
+        } else {
+            cache.put(k, k);
+        }
+    }
+    auto finish = std::chrono::steady_clock::now();
+
+    using ms = std::chrono::duration<double, std::milli>;
+    std::cout << "Perfect: " << hits << "\n";
+    std::cout << "next_use pass: " << ms(prepared - start).count() << " ms\n";
+    std::cout << "replay: " << ms(finish - prepared).count() << " ms\n";
+    std::cout << "peak RSS: " << peak_rss_kb() << " KiB (trace: " << rss_before << " KiB)\n";
+    return 0;
+}
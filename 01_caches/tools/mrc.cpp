@@ -0,0 +1,57 @@
+#include <mrc.hpp>
+#include <shards.hpp>
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// LRU hits for every capacity from 1 to max_capacity as "capacity,hits" CSV.
+// Reads "capacity n k1 ... kn" from stdin like the caches binary, the capacity is ignored.
+// max_capacity defaults to the number of distinct keys, the curve is flat after it.
+// --rate R estimates the curve from a SHARDS sample of R of the keys,
+// --samples S additionally bounds the sample by S keys (lowering the rate when needed).
+// A sampled curve has no resolution below 1/R: the CSV starts at capacity ceil(1/R), and with --samples
+// the rate may end up lower than R. The sample needs about 2000 distinct keys at least, the hit ratios
+// of one that small are already off by 15-25%.
+int main(int argc, char* argv[]) {
+    std::size_t max_capacity = 0, max_samples = 0;
+    double rate = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--rate" && i + 1 < argc) {
+            rate = std::stod(argv[++i]);
+        } else if (arg == "--samples" && i + 1 < argc) {
+            max_samples = std::stoul(argv[++i]);
+        } else if (arg[0] != '-') {
+            max_capacity = std::stoul(arg);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--rate R] [--samples S] [max_capacity] < trace\n"
+                      << "Sampled curves start at capacity ceil(1/R) and need ~2000+ sampled keys\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::size_t m, n;
+    std::cin >> m >> n;
+    std::vector<int> keys(n);
+    for (auto& k : keys) {
+        std::cin >> k;
+    }
+    if (max_capacity == 0) {
+        max_capacity = std::unordered_set<int>(keys.begin(), keys.end()).size();
+    }
+
+    bool sampled = rate < 1 || max_samples > 0;
+    auto hits = sampled ? shards_hits_curve(keys, max_capacity, rate, max_samples)
+        : lru_hits_curve(keys, max_capacity);
+    // a sampled reuse distance of 1 already stands for 1/R
+    auto first = sampled ? static_cast<std::size_t>(std::ceil(1 / rate)) : 1;
+    std::cout << "capacity,hits\n";
+    for (std::size_t c = first; c <= max_capacity; ++c) {
+        std::cout << c << "," << hits[c] << "\n";
+    }
+    return 0;
+}
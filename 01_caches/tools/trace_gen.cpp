@@ -0,0 +1,71 @@
+#include <trace_format.hpp>
+#include <workloads.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Writes a synthetic trace of n requests in the binary trace format (see trace_format.hpp), or in the
+// "capacity n k1 ... kn" text format with --text, streaming it without keeping the keys in memory.
+// The keys are the workload's ranks (0 is the most popular one), not scattered like the in-memory traces
+// of the benchmarks: dense ids keep the binary trace small (see trace_format.hpp).
+// Workloads: zipf, scan, loop, mixed, phases (see workloads.hpp); the phases workload shifts
+// every --phase-length requests, a quarter of the trace by default.
+int usage(const char* name) {
+    std::cerr << "Usage: " << name << " -w workload -k keys -c capacity -n requests [-a alpha] [-s seed]"
+              << " [--phase-length L] (-o trace.bin | --text)\n";
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char* argv[]) {
+    std::string workload = "zipf", output;
+    uint64_t keys = 0, capacity = 0, n = 0, phase_length = 0;
+    double alpha = 0.99;
+    unsigned seed = 42;
+    bool text = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--text") {
+            text = true;
+        } else if (i + 1 == argc) {
+            return usage(argv[0]);
+        } else if (arg == "-w") {
+            workload = argv[++i];
+        } else if (arg == "-k") {
+            keys = std::stoull(argv[++i]);
+        } else if (arg == "-c") {
+            capacity = std::stoull(argv[++i]);
+        } else if (arg == "-n") {
+            n = std::stoull(argv[++i]);
+        } else if (arg == "-a") {
+            alpha = std::stod(argv[++i]);
+        } else if (arg == "-s") {
+            seed = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--phase-length") {
+            phase_length = std::stoull(argv[++i]);
+        } else if (arg == "-o") {
+            output = argv[++i];
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (keys == 0 || capacity == 0 || text == !output.empty()) {
+        return usage(argv[0]);
+    }
+
+    TraceGenerator next(parse_workload(workload), keys, capacity, alpha, seed,
+        phase_length != 0 ? phase_length : n / 4);
+    if (text) {
+        std::cout << capacity << " " << n << "\n";
+        for (uint64_t i = 0; i < n; ++i) {
+            std::cout << next.rank() << "\n";
+        }
+        return 0;
+    }
+    TraceWriter writer(output, capacity);
+    for (uint64_t i = 0; i < n; ++i) {
+        writer.write(static_cast<int>(next.rank()));
+    }
+    writer.finish();
+    return 0;
+}